@@ -0,0 +1,48 @@
+// ActivityTimers.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifndef ACTIVITY_TIMERS_H
+#define ACTIVITY_TIMERS_H
+
+#include <stdint.h>
+#include <functional>
+#include "NesController.h"
+
+class ActivityTimers {
+public:
+    // Actions due, as a bit mask
+    static const uint8_t ACTION_STANDBY = 0x01;            // idle too long, returned alone
+    static const uint8_t ACTION_ENTER_INACTIVE = 0x02;     // connected without input for a while, any power source
+    static const uint8_t ACTION_STOP_ADVERTISING = 0x04;
+
+    // Constructor, timeouts in milliseconds
+    ActivityTimers(uint32_t idleTimeout, uint32_t advertisingTimeout, uint32_t connIdleTimeout);
+
+    // Event methods
+    void markActivity(uint32_t now);            // input, or a state worth the full timeout
+    void markAdvertisingStart(uint32_t now);
+    void leaveInactive();
+
+    // Timer methods, the link state is read by the caller
+    uint8_t check(uint32_t now, bool idle, bool connected, bool advertising, bool externalPower);
+    bool isInactive() const;
+    uint32_t getLastActivityTime() const;
+    uint32_t getAdvertisingStartTime() const;
+
+    // Standby, reads the pad between sleeps until a button is pressed or the timeout runs out.
+    // On a press the timers restart from the wake and the pressed button doesn't count as a gesture.
+    bool waitForPress(NesController& pad, uint32_t timeout, uint32_t pollInterval,
+                      std::function<void(uint32_t milliseconds)> sleep);
+
+private:
+    uint32_t idleTimeout;
+    uint32_t advertisingTimeout;
+    uint32_t connIdleTimeout;
+
+    uint32_t lastActivityTime;
+    uint32_t advertisingStartTime;
+    bool inactive;
+};
+
+#endif // ACTIVITY_TIMERS_H
@@ -9,7 +9,13 @@
 #include <NimBLEServer.h>
 #include <NimBLEUtils.h>
 #include <NimBLEHIDDevice.h>
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "nimble/nimble_port.h"
+#else
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#endif
 #include <functional>
+#include <atomic>
 
 class BLEJoystick {
 public:
@@ -19,14 +25,190 @@ public:
     static const uint8_t DEVICE_ADVERTISING = 2;
     static const uint8_t DEVICE_CONNECTED = 3;
 
-    // Constructor
-    BLEJoystick(std::string deviceName);
+    // Connection parameter profiles
+    static const uint8_t CONN_PROFILE_NONE = 0;
+    static const uint8_t CONN_PROFILE_ACTIVE = 1;
+    static const uint8_t CONN_PROFILE_IDLE = 2;
+
+    // Active profile: 7.5 ms interval, no peripheral latency (1.25 ms / 10 ms units)
+    static const uint16_t ACTIVE_CONN_INTERVAL_MIN = 6;
+    static const uint16_t ACTIVE_CONN_INTERVAL_MAX = 12;
+    static const uint16_t ACTIVE_CONN_LATENCY = 0;
+    static const uint16_t ACTIVE_CONN_TIMEOUT = 400;
+
+    // Idle profile: relaxed interval, skip up to 4 connection events
+    static const uint16_t IDLE_CONN_INTERVAL_MIN = 48;
+    static const uint16_t IDLE_CONN_INTERVAL_MAX = 60;
+    static const uint16_t IDLE_CONN_LATENCY = 4;
+    static const uint16_t IDLE_CONN_TIMEOUT = 600;
+
+    // Largest LE data length PDU payload (octets)
+    static const uint16_t MAX_DATA_LEN = 251;
+
+    // Fast reconnect: directed advertising to the last bonded host before general advertising
+    static const uint32_t DIRECTED_ADV_DURATION = 1;     // seconds, the shortest NimBLEAdvertising::start() takes
+    static const uint16_t DIRECTED_ADV_INTERVAL = 32;    // 0.625 ms units (20 ms), low duty cycle minimum
+
+    // Simultaneous host connections
+    static const uint8_t MAX_PEERS = 3;
+
+    // Host slots
+    static const uint8_t HOST_SLOTS = 3;
+    static const uint8_t NO_HOST_SLOT = 0xFF;
+
+    // Advertising schedule
+    static const uint8_t MAX_ADV_TIERS = 4;
+    static const uint8_t ADV_TIER_DIRECTED = 0xFF;
+    static const uint32_t ADV_EVENT_CHARGE = 40;         // microcoulombs per advertising event (3 channels)
+
+    struct AdvertisingTier {
+        uint32_t duration;      // seconds as NimBLEAdvertising::start() takes them, 0 = until advertising stops
+        uint16_t minInterval;   // 0.625 ms units
+        uint16_t maxInterval;   // 0.625 ms units
+    };
+
+    struct AdvertisingTierStats {
+        uint32_t time;          // milliseconds spent advertising in this tier
+        uint32_t events;        // estimated advertising events
+        uint32_t charge;        // estimated microcoulombs used
+        uint16_t connects;      // connections made during this tier
+        uint32_t connectTime;   // summed milliseconds from advertising start to connection
+    };
+
+    // HID input report size (buttons, hat, X, Y)
+    static const uint8_t REPORT_SIZE = 5;
+
+    // Tap delivery: distinct report states queued per peer and sent in order. A state held for the
+    // minimum tap duration is only seen if the pad is read at least that often, which the firmware
+    // does in every mode except while all hosts suspended HID. Builds with HID_REPORT_DEBUG print
+    // every report and can't keep that read interval.
+    static const uint8_t REPORT_QUEUE_SIZE = 8;
+    static const uint16_t MIN_TAP_DURATION = 16;        // milliseconds
+
+    // Input reports a peer may have in the stack before its queue waits, so a host that stops
+    // taking them can't use up the buffer pool all peers share (12 buffers on the ESP32)
+    static const uint8_t MAX_TX_IN_FLIGHT = 3;
+
+    // TX power control: 3 dB steps between a floor and the default level
+    static const esp_power_level_t TX_POWER_MIN = ESP_PWR_LVL_N12;
+    static const esp_power_level_t TX_POWER_MAX = ESP_PWR_LVL_P9;
+    static const uint32_t LINK_SAMPLE_INTERVAL = 1000;      // milliseconds between RSSI samples
+    static const int8_t TX_POWER_RSSI_HIGH = -60;           // dBm, strong enough to step down
+    static const int8_t TX_POWER_RSSI_LOW = -75;            // dBm, weak enough to step up
+    static const uint8_t TX_POWER_FAIL_PERCENT = 5;         // notify failures that force a step up
+    static const uint8_t TX_POWER_HOLD_SAMPLES = 5;         // good samples in a row before stepping down
+
+    // Radio considered quiet this long after the last notification
+    static const uint32_t RADIO_QUIET_TIME = 20;        // milliseconds
+
+    // HID Control Point commands
+    static const uint8_t HID_CONTROL_SUSPEND = 0x00;
+    static const uint8_t HID_CONTROL_EXIT_SUSPEND = 0x01;
+
+    // Link telemetry
+    static const uint8_t LINK_HISTORY_SIZE = 4;         // closed connections kept
+    static const uint8_t DIAGNOSTICS_VERSION = 3;
+
+    // Fixed-size statistics of one connection, also the diagnostic characteristic record
+    struct __attribute__((packed)) LinkStats {
+        uint32_t duration;          // milliseconds connected
+        uint32_t notifySent;
+        uint32_t notifyFailed;
+        uint32_t mbufExhausted;     // notifies that failed for lack of buffers
+        uint16_t connUpdates;       // connection parameter updates applied
+        uint16_t rssiSamples;
+        int8_t rssiMin;             // dBm
+        int8_t rssiMax;
+        int8_t rssiAvg;
+        uint8_t hostSlot;
+        uint16_t disconnectReason;  // GAP disconnect reason, 0 while connected
+    };
+
+    // Diagnostic characteristic header, followed by LinkStats of live then closed connections
+    struct __attribute__((packed)) DiagnosticsHeader {
+        uint8_t version;
+        uint8_t peerCount;
+        uint8_t historyCount;
+        int8_t txPower;             // dBm
+        uint16_t connects;
+        uint16_t disconnects;
+        uint16_t supervisionTimeouts;
+        uint32_t suspendedTime;     // milliseconds all hosts had HID suspended
+        uint16_t firstPressLatency; // worst case milliseconds from the pad read to the report handed to the stack, out of the connected-inactive mode
+    };
+
+    // Per-connection link state
+    struct PeerLink {
+        uint16_t connHandle;
+        uint8_t hostSlot;           // NO_HOST_SLOT until the host is bonded
+        uint8_t connProfile;
+        uint16_t connInterval;      // 1.25 ms units
+        uint16_t connLatency;       // connection events
+        uint16_t connTimeout;       // 10 ms units
+        int connParamsStatus;       // status of last update, 0 on success
+        uint8_t txPhy;              // BLE_GAP_LE_PHY_1M / 2M / CODED
+        uint8_t rxPhy;
+        int phyStatus;              // status of last PHY update, 0 on success
+        bool subscribed;            // input report notifications enabled
+        bool suspended;             // host wrote Suspend to the HID Control Point
+        uint8_t queue[REPORT_QUEUE_SIZE][REPORT_SIZE]; // report states not yet accepted for this peer
+        uint32_t queueTime[REPORT_QUEUE_SIZE];          // millis() each state began
+        uint8_t queueHead;
+        uint8_t queueCount;
+        uint8_t txInFlight;         // input reports handed to the stack, not yet reported sent
+        uint32_t notifyDeferred;    // sends held back at MAX_TX_IN_FLIGHT
+        uint32_t notifySent;
+        uint32_t notifyFailed;
+        uint32_t statesRecovered;   // superseded states (short taps) latest-state delivery would have lost
+        uint32_t statesMerged;      // states shorter than the minimum tap duration folded into the next
+        uint32_t statesDropped;     // states of at least the minimum duration lost to a full queue
+        int8_t rssi;                // last sampled RSSI, dBm
+        int8_t rssiMin;
+        int8_t rssiMax;
+        int32_t rssiSum;
+        uint16_t rssiSamples;
+        uint16_t connUpdates;
+        uint32_t mbufExhausted;
+        uint32_t sampledSent;       // notify counters at the last TX power sample
+        uint32_t sampledFailed;
+        uint32_t linkUpTime;        // millis() at connection
+        uint32_t encryptTime;       // milliseconds from link-up to encryption, 0 until encrypted
+        uint32_t subscribeTime;     // milliseconds from link-up to input report subscription
+        uint32_t firstReportTime;   // milliseconds from link-up to first delivered report
+    };
+
+    // Bonded host slot with cached connection preferences
+    struct HostSlot {
+        ble_addr_t addr;
+        uint8_t valid;
+        uint8_t phy;                // last PHY the host accepted
+        uint8_t age;                // hosts used since this one, 0 for the most recent
+        uint16_t connInterval;      // last active interval the host accepted, 1.25 ms units
+    };
+
+    // State carried across deep sleep in RTC memory
+    struct RetainedState {
+        HostSlot hostSlots[HOST_SLOTS];
+        uint8_t activeHostSlot;
+        uint16_t connectCount;
+        uint16_t disconnectCount;
+        uint16_t supervisionTimeouts;
+        uint32_t suspendedTime;
+    };
+
+    // GATT database layout, bump when services or characteristics are added, removed or reordered
+    // so bonded hosts get a Service Changed indication once instead of on every boot
+    static const uint32_t GATT_LAYOUT_VERSION = 4;
+
+    // Constructor, restores host slots and counters from retained state instead of flash when given
+    BLEJoystick(std::string deviceName, const RetainedState* retained = nullptr);
     
     // Device control methods
     void start();
     void stop();
     void startAdvertising();
     void stopAdvertising();
+    bool isAdvertising() const;
     void disconnect();
     
     // Input state setters
@@ -37,31 +219,177 @@ public:
                 int16_t rX = 0, int16_t rY = 0, int16_t slider1 = 0, int16_t slider2 = 0);
     void setHat(uint8_t hat);
     void notifyHIDReport();
+    void flushReports();
+    void setTapDelivery(bool enabled, uint16_t minDuration = MIN_TAP_DURATION);
     
     // Battery level methods
     void setBatteryLevel(uint8_t level);
     void notifyBatteryLevel();
+    void setPowerState(bool externalPower, bool charging);
+    void setBatteryCritical(bool critical);
+    uint8_t getPowerState() const;      // Battery Power State (0x2A1A) value
     
     // State methods
     uint8_t getState() const;
     void setStateChangeCallback(std::function<void()> callback);
     
+    // Peer methods
+    uint8_t getPeerCount() const;
+    const PeerLink* getPeer(uint8_t index) const;
+    
+    // Connection parameter methods (all peers, getters default to the first peer)
+    void requestActiveConnParams();
+    void requestIdleConnParams();
+    uint8_t getConnProfile(uint8_t peer = 0) const;
+    uint16_t getConnInterval(uint8_t peer = 0) const;
+    uint16_t getConnLatency(uint8_t peer = 0) const;
+    uint16_t getConnTimeout(uint8_t peer = 0) const;
+    int getConnParamsStatus(uint8_t peer = 0) const;
+    
+    // PHY methods
+    uint8_t getTxPhy(uint8_t peer = 0) const;
+    uint8_t getRxPhy(uint8_t peer = 0) const;
+    int getPhyStatus(uint8_t peer = 0) const;
+    
+    // TX power methods
+    void setAutoTxPower(bool enabled);
+    void setTxPowerLimit(esp_power_level_t limit);  // highest level used, TX_POWER_MAX by default
+    void updateLinkQuality();           // call from the main loop, samples every LINK_SAMPLE_INTERVAL
+    int8_t getTxPower() const;          // dBm
+    int8_t getRssi(uint8_t peer = 0) const;
+    float getTxEnergySaved() const;     // estimated microamp-hours saved against TX_POWER_MAX
+    
+    // Link telemetry methods
+    LinkStats getLinkStats(uint8_t peer) const;
+    uint8_t getLinkHistoryCount() const;
+    const LinkStats& getLinkHistory(uint8_t index) const;   // 0 = most recent
+    uint16_t getConnectCount() const;
+    uint16_t getSupervisionTimeouts() const;
+    void printLinkStats() const;
+    uint32_t getNotifyCount() const;    // notifications sent since boot, all characteristics
+    void markFirstPress(uint32_t edgeTime);   // micros() of the read that saw the press, timed to the report handed to the stack
+    uint16_t getFirstPressLatency() const;    // worst case milliseconds, published in the diagnostics header
+    void setEnergyReport(const uint8_t* data, size_t length);
+    bool isRadioQuiet();                // no notification pending or recently sent, from any task
+    
+    // HID suspend methods
+    bool isSuspended() const;           // every connected host suspended HID
+    uint32_t getSuspendedTime() const;  // total milliseconds suspended
+    
+    // Pairing methods
+    void generatePairingKey();              // once, from the loop before the first host connects
+    bool isPairingKeyReady() const;
+    uint32_t getPairingKeyTime() const;     // microseconds spent generating the P-256 key pair
+    uint32_t getLastPairingTime() const;    // milliseconds from link-up to a new bond
+    
+    // Deep sleep methods
+    void retainState(RetainedState& state);     // flushes host slots and fills state before sleeping
+    
+    // Reconnect methods
+    void setFastReconnect(bool enabled);
+    bool isReconnecting() const;        // directed advertising to the last host
+    uint32_t getLastConnectTime() const; // milliseconds from advertising start to connection
+    bool wasLastConnectDirected() const;
+    
+    // Host slot methods
+    void selectHost(uint8_t slot);
+    void nextHost();
+    void forgetHost(uint8_t slot);
+    uint8_t getActiveHost() const;
+    bool hasHost(uint8_t slot) const;
+    
+    // Advertising schedule methods
+    void setAdvertisingSchedule(const AdvertisingTier* tiers, uint8_t count);
+    uint8_t getAdvertisingTier() const;
+    uint8_t getLastConnectTier() const;
+    const AdvertisingTierStats& getAdvertisingTierStats(uint8_t tier) const;
+    void printAdvertisingStats() const;
+    
 private:
     // BLE objects
     NimBLEServer* pServer;
     NimBLEHIDDevice* pHidDevice;
     NimBLECharacteristic* pInputCharacteristic;
     NimBLECharacteristic* pBatteryCharacteristic;
+    NimBLECharacteristic* pPowerStateCharacteristic;
+    NimBLECharacteristic* pDiagnosticsCharacteristic;
+    NimBLECharacteristic* pEnergyCharacteristic;
     
     // Device state
     uint8_t deviceState;
     uint8_t batteryLevel;
+    bool externalPower;
+    bool charging;
+    bool batteryCritical;
+    uint8_t powerState;
     std::function<void()> stateChangeCallback;
     
+    // Connected peers, in connection order, changed by the NimBLE host task while the loop sends
+    PeerLink peers[MAX_PEERS];
+    uint8_t peerCount;
+    ble_npl_mutex peerMutex;    // recursive, guards peers and their report queues
+    
+    // TX power control
+    bool autoTxPower;
+    esp_power_level_t txPowerLevel;
+    esp_power_level_t txPowerLimit;
+    uint8_t txPowerHold;
+    uint32_t lastTxPowerSample;
+    float txEnergySaved;
+    
+    // Link telemetry
+    LinkStats linkHistory[LINK_HISTORY_SIZE];
+    uint8_t linkHistoryHead;
+    uint8_t linkHistoryCount;
+    uint16_t connectCount;
+    uint16_t disconnectCount;
+    uint16_t supervisionTimeouts;
+    std::atomic<uint32_t> lastNotifyTime;  // also read by isRadioQuiet() from other tasks
+    uint32_t notifyCount;
+    uint16_t firstPressLatency;
+    uint32_t firstPressEdge;
+    bool firstPressPending;
+    
+    // HID suspend
+    bool suspended;
+    uint32_t suspendStartTime;
+    uint32_t suspendedTime;
+    
+    // LE Secure Connections key pair precomputation
+    std::atomic<uint8_t> pairingKeyState;  // claimed by the loop to generate, or by a new host to leave it to pairing
+    uint32_t pairingKeyTime;
+    uint32_t lastPairingTime;
+    
+    // Reconnect state
+    bool fastReconnect;
+    bool advertising;
+    std::atomic<bool> directedAdvertising;  // also read by isRadioQuiet() from other tasks
+    
+    // Bonded host slots with cached connection preferences
+    HostSlot hostSlots[HOST_SLOTS];
+    uint8_t activeHostSlot;
+    bool hostSlotsDirty;
+    uint32_t advertisingStartTime;
+    uint32_t lastConnectTime;
+    bool lastConnectDirected;
+    
+    // Advertising schedule
+    AdvertisingTier advTiers[MAX_ADV_TIERS];
+    AdvertisingTierStats advTierStats[MAX_ADV_TIERS];
+    uint8_t advTierCount;
+    uint8_t advTier;
+    uint32_t advTierStartTime;
+    uint8_t lastConnectTier;
+    NimBLEAdvertisementData advData;
+    NimBLEAdvertisementData scanResponseData;
+    
     // HID report data
     uint8_t buttons[2];         // 12 buttons (12 bits)
     int16_t axes[8];            // 8 axes (X, Y, Z, RZ, RX, RY, Slider1, Slider2)
     uint8_t hat;                // hat direction (0-8)
+    uint8_t report[REPORT_SIZE]; // last packed input report
+    bool tapDelivery;
+    uint16_t minTapDuration;
     
     // HID report descriptor
     static const uint8_t hidReportDescriptor[];
@@ -71,13 +399,65 @@ private:
     public:
         ServerCallbacks(BLEJoystick* device);
         void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc);
-        void onDisconnect(NimBLEServer* pServer);
+        void onDisconnect(NimBLEServer* pServer, ble_gap_conn_desc* desc);
+        void onAuthenticationComplete(ble_gap_conn_desc* desc);
+        
+    private:
+        BLEJoystick* device;
+    };
+    
+    // HID Control Point callbacks
+    class HidControlCallbacks : public NimBLECharacteristicCallbacks {
+    public:
+        HidControlCallbacks(BLEJoystick* device);
+        void onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc);
         
     private:
         BLEJoystick* device;
     };
     
+    // Diagnostic characteristic callbacks
+    class DiagnosticsCallbacks : public NimBLECharacteristicCallbacks {
+    public:
+        DiagnosticsCallbacks(BLEJoystick* device);
+        void onRead(NimBLECharacteristic* pCharacteristic);
+        
+    private:
+        BLEJoystick* device;
+    };
+    
+    // GAP event handler (connection parameter updates)
+    static BLEJoystick* instance;
+    static int handleGapEvent(ble_gap_event* event, void* arg);
+    
     void updateDeviceState(uint8_t newState);
+    void lockPeers();
+    void unlockPeers();
+    PeerLink* findPeer(uint16_t connHandle);
+    PeerLink* addPeer(const ble_gap_conn_desc* desc);
+    void removePeer(uint16_t connHandle);
+    void queueReport(PeerLink& peer);
+    void sendReports(PeerLink& peer);
+    void requestConnParams(PeerLink& peer, uint8_t profile);
+    void refreshConnParams(PeerLink& peer);
+    void requestFastPhy(PeerLink& peer);
+    void setTxPowerLevel(esp_power_level_t level);
+    LinkStats makeLinkStats(const PeerLink& peer) const;
+    void recordLinkHistory(const PeerLink& peer, uint16_t reason);
+    void updateDiagnostics();
+    void updatePowerState();
+    void updateSuspendState();
+    void waitForPairingKey();
+    void buildAdvertisingData(const std::string& deviceName);
+    void startAdvertisingTier(uint8_t tier);
+    void endAdvertisingTier();
+    void checkGattLayout();
+    void loadHostSlots();
+    void saveHostSlots();
+    uint8_t findHostSlot(const ble_addr_t& addr) const;
+    uint8_t assignHostSlot(const ble_addr_t& addr);
+    bool isHostConnected(uint8_t slot) const;
+    static void onAdvertisingComplete(NimBLEAdvertising* pAdvertising);
 };
 
 #endif // BLE_JOYSTICK_H
@@ -0,0 +1,112 @@
+// BatteryMonitor.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifndef BATTERY_MONITOR_H
+#define BATTERY_MONITOR_H
+
+#include <Arduino.h>
+#include <functional>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+class BatteryMonitor {
+public:
+    // Oversampling: samples per measurement, trimmed at both ends before averaging
+    static const uint8_t SAMPLE_COUNT = 16;
+    static const uint8_t SAMPLE_TRIM = 4;
+
+    // Scheduling, samples are taken by a task below the loop's priority
+    static const uint32_t MEASURE_INTERVAL = 5000;     // milliseconds between measurements
+    static const uint32_t SAMPLE_SPACING = 20;         // minimum milliseconds between samples
+    static const uint32_t RADIO_WAIT_LIMIT = 1000;     // sample anyway after waiting this long for a quiet radio
+    static const uint32_t TASK_STACK_SIZE = 2048;
+
+    // State of charge
+    static const uint16_t CELL_RESISTANCE = 150;       // milliohms, cell plus protection and wiring
+    static const uint8_t LEVEL_HYSTERESIS = 2;         // percent the estimate must move before it's reported
+    static const uint32_t LEVEL_HOLD_TIME = 60000;     // minimum milliseconds between reported changes
+
+    // Charge states
+    static const uint8_t CHARGE_UNKNOWN = 0;
+    static const uint8_t CHARGE_DISCHARGING = 1;       // running from the cell
+    static const uint8_t CHARGE_CHARGING = 2;
+    static const uint8_t CHARGE_FULL = 3;              // on external power, charge terminated
+
+    // Charger sensing
+    static const uint8_t NO_PIN = 0xFF;
+    static const uint32_t CHARGE_DEBOUNCE = 500;       // milliseconds a charger state must hold
+    static const uint16_t CHARGE_CURRENT = 300;        // mA, charger programmed current
+    static const uint16_t CHARGE_RISE = 30;            // millivolts between measurements that mean a charger came or went
+
+    // Constructor, divider is battery voltage / ADC pin voltage
+    BatteryMonitor(uint8_t pin, float divider = 1.0);
+
+    // Measurement methods
+    void begin();                       // starts the sampling task, first measurement after MEASURE_INTERVAL
+    void setRadioQuietCallback(std::function<bool()> callback);    // asked from the sampling task
+    bool update();                      // never waits on the ADC, true when a measurement completes
+    uint16_t measure();                 // blocking full measurement, before the task's first one
+    bool isValid() const;
+    uint16_t getMilliVolts() const;     // battery voltage of the last measurement
+    uint16_t getSpread() const;         // millivolts between the trimmed extremes, a noise indicator
+    bool isCalibrated() const;          // ADC characterized from eFuse values
+
+    // State of charge methods
+    void setLoadCurrent(uint16_t milliAmps);    // average draw, used to undo the cell's voltage sag
+    uint16_t getOpenCircuitMilliVolts() const;
+    uint8_t getEstimatedLevel() const;  // unfiltered percentage from the last measurement
+    uint8_t getLevel() const;           // reported percentage, changes only past the hysteresis
+    void restoreLevel(uint8_t level);   // continue from a level reported before deep sleep
+
+    // Charger methods
+    void setChargePins(uint8_t chargePin, uint8_t standbyPin);  // active low, NO_PIN to infer from voltage
+    uint8_t getChargeState() const;
+    bool isExternalPower() const;
+
+private:
+    uint8_t pin;
+    float divider;
+    bool calibrated;
+
+    // Trimmed average of one round of samples, handed from the task to update()
+    struct Measurement {
+        uint16_t pinMilliVolts;
+        uint16_t spread;
+    };
+
+    // Sampling task
+    TaskHandle_t task;
+    QueueHandle_t results;
+    std::function<bool()> radioQuietCallback;
+
+    // Last result
+    bool valid;
+    uint16_t milliVolts;
+    uint16_t spread;
+
+    // State of charge
+    uint16_t loadMilliAmps;
+    uint8_t estimatedLevel;
+    uint8_t level;
+    bool levelValid;
+    uint32_t levelTime;
+
+    // Charger
+    uint8_t chargePin;
+    uint8_t standbyPin;
+    uint8_t chargeState;
+    uint8_t pendingChargeState;
+    uint32_t pendingChargeTime;
+
+    Measurement acquire(bool spaced);
+    void waitForQuietRadio();
+    void finishMeasurement(const Measurement& measurement);
+    static void sampleTask(void* arg);
+    void updateLevel();
+    void readChargePins();
+    void inferChargeState(uint16_t previousMilliVolts);
+};
+
+#endif // BATTERY_MONITOR_H
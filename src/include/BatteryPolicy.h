@@ -0,0 +1,48 @@
+// BatteryPolicy.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifndef BATTERY_POLICY_H
+#define BATTERY_POLICY_H
+
+#include <Arduino.h>
+
+class BatteryPolicy {
+public:
+    // Degradation stages, each includes the savings of the ones before
+    static const uint8_t STAGE_NORMAL = 0;
+    static const uint8_t STAGE_LOW = 1;            // light dimmed, no blinking
+    static const uint8_t STAGE_CRITICAL = 2;       // reduced TX power and poll rate
+    static const uint8_t STAGE_SHUTDOWN = 3;       // disconnect and power off cleanly
+
+    // Default thresholds
+    static const uint8_t DEFAULT_LOW_LEVEL = 15;           // percent
+    static const uint8_t DEFAULT_CRITICAL_LEVEL = 5;       // percent
+    static const uint8_t DEFAULT_SHUTDOWN_LEVEL = 1;       // percent
+    static const uint16_t DEFAULT_SHUTDOWN_MILLIVOLTS = 3300;   // ahead of the boost converter dropping out
+
+    static const uint8_t STAGE_HYSTERESIS = 3;     // percent above a threshold before a stage is left
+    static const uint8_t SHUTDOWN_CONFIRM = 3;     // measurements under the cutoff voltage before shutting down
+
+    // Constructor
+    BatteryPolicy();
+
+    // Policy methods
+    void setThresholds(uint8_t low, uint8_t critical, uint8_t shutdown, uint16_t shutdownMilliVolts);
+    bool update(uint8_t level, uint16_t milliVolts, bool externalPower);  // true when the stage changed
+    uint8_t getStage() const;
+    const char* getStageName() const;
+
+private:
+    uint8_t lowLevel;
+    uint8_t criticalLevel;
+    uint8_t shutdownLevel;
+    uint16_t shutdownMilliVolts;
+
+    uint8_t stage;
+    uint8_t undervoltageCount;
+
+    uint8_t stageFor(uint8_t level, uint8_t margin) const;
+};
+
+#endif // BATTERY_POLICY_H
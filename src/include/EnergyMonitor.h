@@ -0,0 +1,92 @@
+// EnergyMonitor.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifndef ENERGY_MONITOR_H
+#define ENERGY_MONITOR_H
+
+#include <Arduino.h>
+
+class EnergyMonitor {
+public:
+    // Power states
+    static const uint8_t STATE_STOPPED = 0;
+    static const uint8_t STATE_IDLE = 1;
+    static const uint8_t STATE_ADVERTISING = 2;
+    static const uint8_t STATE_CONNECTED_ACTIVE = 3;
+    static const uint8_t STATE_CONNECTED_IDLE = 4;
+    static const uint8_t STATE_STANDBY = 5;        // light-sleep polling
+    static const uint8_t STATE_SLEEP = 6;          // deep sleep
+    static const uint8_t STATE_COUNT = 7;
+
+    // Charge not covered by the state currents
+    static const uint32_t NOTIFY_CHARGE = 3;       // microcoulombs per notification (TX and RX window)
+    static const uint32_t CPU_BUSY_CURRENT = 8000; // microamps above the state current while busy
+
+    static const uint16_t DEFAULT_CAPACITY = 1000; // mAh
+    static const uint8_t REPORT_VERSION = 1;
+
+    // Energy characteristic value
+    struct __attribute__((packed)) EnergyReport {
+        uint8_t version;
+        uint8_t state;
+        uint8_t batteryLevel;       // percent
+        uint8_t reserved;
+        uint32_t stateTime[STATE_COUNT];    // seconds
+        uint32_t txCount;           // notifications sent
+        uint32_t cpuBusyTime;       // milliseconds
+        uint32_t consumed;          // microamp-hours
+        uint32_t averageCurrent;    // microamps
+        uint32_t remainingTime;     // minutes at the average current, 0 if unknown
+    };
+
+    // Totals carried across deep sleep
+    struct RetainedState {
+        uint32_t stateTime[STATE_COUNT];    // milliseconds
+        uint32_t txCount;
+        uint64_t cpuBusyTime;       // microseconds
+    };
+
+    // Constructor
+    EnergyMonitor();
+
+    // Configuration methods
+    void setStateCurrent(uint8_t state, uint32_t microAmps);
+    uint32_t getStateCurrent(uint8_t state) const;
+    void setCapacity(uint16_t mAh);
+
+    // Accounting methods
+    void setState(uint8_t state);
+    uint8_t getState() const;
+    void addStateTime(uint8_t state, uint32_t milliseconds);    // time spent where the monitor couldn't run
+    void update(uint32_t txCount, uint32_t cpuBusyTime);        // cumulative counters, microseconds of CPU
+    void restore(const RetainedState& state);
+    void retain(RetainedState& state);
+
+    // Estimation methods
+    uint32_t getStateTime(uint8_t state) const;     // milliseconds
+    uint32_t getConsumed() const;                   // microamp-hours
+    uint32_t getAverageCurrent() const;             // microamps
+    uint32_t getRemainingTime(uint8_t batteryLevel) const;  // minutes
+    EnergyReport getReport(uint8_t batteryLevel) const;
+    void printStats(uint8_t batteryLevel) const;
+
+private:
+    uint32_t stateCurrent[STATE_COUNT];
+    uint16_t capacity;
+
+    uint8_t state;
+    uint32_t stateStartTime;
+    uint32_t stateTime[STATE_COUNT];
+    uint32_t txCount;
+    uint64_t cpuBusyTime;
+
+    // Last cumulative counters seen
+    uint32_t lastTxCount;
+    uint32_t lastCpuBusyTime;
+
+    uint64_t getCharge() const;         // microamp-milliseconds
+    uint32_t getTotalTime() const;
+};
+
+#endif // ENERGY_MONITOR_H
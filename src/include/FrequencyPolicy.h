@@ -0,0 +1,64 @@
+// FrequencyPolicy.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifndef FREQUENCY_POLICY_H
+#define FREQUENCY_POLICY_H
+
+#include <Arduino.h>
+#ifdef CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+class FrequencyPolicy {
+public:
+    // CPU clock limits, 80 MHz is the lowest that keeps APB and the radio at full speed
+    static const uint32_t MAX_FREQ = 160;      // MHz
+    static const uint32_t MIN_FREQ = 80;       // MHz
+
+    // Firmware states the policy is profiled for
+    static const uint8_t PROFILE_IDLE = 0;
+    static const uint8_t PROFILE_ADVERTISING = 1;
+    static const uint8_t PROFILE_CONNECTED_IDLE = 2;   // connected on the idle connection profile
+    static const uint8_t PROFILE_PLAY = 3;             // connected on the active connection profile
+    static const uint8_t PROFILE_COUNT = 4;
+
+    struct ProfileStats {
+        uint32_t time;          // milliseconds in this profile
+        uint32_t work;          // input/report passes
+        uint32_t busyTime;      // summed microseconds inside the input/report path
+        uint32_t maxBusyTime;   // longest pass, microseconds
+    };
+
+    // Constructor
+    FrequencyPolicy();
+
+    // Policy methods
+    void begin();
+    void setProfile(uint8_t profile);
+    uint8_t getProfile() const;
+    bool isDynamic() const;             // esp_pm scales the clock, otherwise fixed per profile
+
+    // Input/report path, runs at MAX_FREQ
+    void beginWork();
+    void endWork();
+
+    // Profiling methods
+    const ProfileStats& getProfileStats(uint8_t profile) const;
+    uint32_t getBusyTime() const;       // microseconds in the input/report path, all profiles
+    void printStats() const;
+
+private:
+    uint8_t profile;
+    uint32_t profileStartTime;
+    uint32_t workStartTime;
+    bool dynamic;
+    ProfileStats stats[PROFILE_COUNT];
+#ifdef CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t workLock;
+#endif
+
+    uint32_t profileFrequency(uint8_t profile) const;
+};
+
+#endif // FREQUENCY_POLICY_H
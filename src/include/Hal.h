@@ -0,0 +1,49 @@
+// Hal.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#ifndef ARDUINO
+#include <functional>
+#endif
+
+// Board access for the portable firmware logic, implemented in HalEsp32.cpp on the
+// target and in HalLinux.cpp for native builds
+class Hal {
+public:
+    // GPIO
+    static void pinOutput(uint8_t pin);
+    static void pinInput(uint8_t pin, bool pullup = false);
+    static void writePin(uint8_t pin, bool high);
+    static bool readPin(uint8_t pin);
+
+    // Clock
+    static uint32_t millis();
+    static uint32_t micros();
+    static void delay(uint32_t milliseconds);
+    static void delayMicros(uint32_t microseconds);
+
+    // ADC
+    static uint16_t readMilliVolts(uint8_t pin);    // calibrated pin voltage
+
+    // Sleep, wake sources are set up by the caller
+    static bool lightSleep(uint32_t milliseconds);  // false if the sleep was rejected
+    static void deepSleep();                        // does not return
+
+    // Power key of the power bank chip, active low
+    static void setPowerKeyPin(uint8_t pin);
+    static void pressPowerKey(uint32_t milliseconds);
+    static void releasePowerKey();
+
+#ifndef ARDUINO
+    // Simulation hooks, native builds only
+    static void setOutputHook(std::function<void(uint8_t pin, bool high)> hook);
+    static void setInputHook(std::function<bool(uint8_t pin)> hook);
+    static void setMilliVolts(uint8_t pin, uint16_t milliVolts);
+#endif
+};
+
+#endif // HAL_H
@@ -0,0 +1,63 @@
+// LedDriver.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifndef LED_DRIVER_H
+#define LED_DRIVER_H
+
+#include <Arduino.h>
+#include "driver/ledc.h"
+#include "esp_timer.h"
+
+class LedDriver {
+public:
+    // Patterns
+    static const uint8_t PATTERN_OFF = 0;
+    static const uint8_t PATTERN_ON = 1;           // steady, PWM dimmed
+    static const uint8_t PATTERN_BLINK = 2;        // LEDC timer at the blink rate
+    static const uint8_t PATTERN_BREATHE = 3;      // hardware fades, reversed when each one ends
+
+    // PWM for steady and breathing light, the slow clock keeps running in light sleep
+    static const uint32_t PWM_FREQUENCY = 500;     // Hz
+    static const ledc_timer_bit_t PWM_RESOLUTION = LEDC_TIMER_10_BIT;
+    static const ledc_timer_bit_t BLINK_RESOLUTION = LEDC_TIMER_14_BIT;  // widest the C3 has
+    // Hz, 1 Hz at 14 bits needs a divider of 1068 from the 17.5 MHz RC clock and the C3 stops at 1023,
+    // so the slowest blink the hardware holds alone is 2 Hz
+    static const uint8_t MIN_BLINK_FREQUENCY = 2;
+
+    // Constructor
+    LedDriver(uint8_t pin, bool activeLow = true);
+
+    // Pattern methods, repeating the current pattern costs nothing
+    void begin();
+    void end();                         // dark, and the RC clock free to power down again
+    void off();
+    void on(uint8_t brightness = 255);
+    void blink(uint8_t frequency = MIN_BLINK_FREQUENCY, uint8_t dutyPercent = 50);   // Hz, percent of the period lit
+    void breathe(uint16_t period = 2000, uint8_t brightness = 255); // milliseconds per cycle
+    uint8_t getPattern() const;
+
+private:
+    uint8_t pin;
+    bool activeLow;
+    uint8_t pattern;
+    uint16_t parameter1;
+    uint16_t parameter2;
+
+    // Breathing, a running fade holds the channel until it ends
+    esp_timer_handle_t timer;
+    volatile bool breathing;
+    volatile bool fading;
+    bool breatheRising;
+
+    bool setPattern(uint8_t pattern, uint16_t parameter1, uint16_t parameter2);
+    void apply();
+    void reverseFade();
+    void configureTimer(uint32_t frequency, ledc_timer_bit_t resolution);
+    void setDuty(uint32_t duty);
+    static uint32_t scaleDuty(uint8_t brightness, ledc_timer_bit_t resolution);
+    static bool onFadeEnd(const ledc_cb_param_t* param, void* arg);
+    static void onTimer(void* arg);
+};
+
+#endif // LED_DRIVER_H
@@ -0,0 +1,75 @@
+// NesController.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifndef NES_CONTROLLER_H
+#define NES_CONTROLLER_H
+
+#include <stdint.h>
+#include "Hal.h"
+
+class NesController {
+public:
+    // Buttons in shift register order
+    static const uint8_t BUTTON_A = 0;
+    static const uint8_t BUTTON_B = 1;
+    static const uint8_t BUTTON_SELECT = 2;
+    static const uint8_t BUTTON_START = 3;
+    static const uint8_t BUTTON_UP = 4;
+    static const uint8_t BUTTON_DOWN = 5;
+    static const uint8_t BUTTON_LEFT = 6;
+    static const uint8_t BUTTON_RIGHT = 7;
+    static const uint8_t BUTTON_COUNT = 8;
+
+    // 4021 shift register timing
+    static const uint32_t LATCH_PULSE = 12;         // microseconds, minimum
+    static const uint32_t CLOCK_HALF_PERIOD = 6;    // microseconds
+
+    // Hold and chord gestures
+    static const uint32_t POWER_OFF_HOLD_TIME = 5000;   // milliseconds holding START
+    static const uint32_t RECONNECT_HOLD_TIME = 5000;   // milliseconds holding SELECT
+    static const uint32_t CHORD_HOLD_TIME = 500;        // milliseconds holding a SELECT chord
+
+    // Gesture events, as a bit mask
+    static const uint8_t EVENT_POWER_OFF = 0x01;    // START held
+    static const uint8_t EVENT_RECONNECT = 0x02;    // SELECT held
+    static const uint8_t EVENT_NEXT_HOST = 0x04;    // SELECT + A held
+    static const uint8_t EVENT_ADD_HOST = 0x08;     // SELECT + B held
+
+    // Constructor
+    NesController(uint8_t clockPin, uint8_t latchPin, uint8_t dataPin);
+
+    // Pad methods
+    void begin();
+    bool read();                        // true when any button changed
+    bool isPressed(uint8_t button) const;
+    bool isReported(uint8_t button) const;  // pressed and not held for a chord
+    bool isAnyPressed() const;
+    uint8_t getButtons() const;         // bit per button, shift register order
+
+    // Report values
+    uint8_t getHat() const;             // 0 = centered, 1-8 clockwise from up
+    int8_t getX() const;
+    int8_t getY() const;
+
+    // Gesture methods
+    uint8_t updateGestures(uint32_t now);   // events completed this call
+    bool isSelectHeld() const;              // timing a SELECT hold
+    void resetGestures();                   // forget held buttons, e.g. the one that woke the pad
+
+private:
+    uint8_t clockPin;
+    uint8_t latchPin;
+    uint8_t dataPin;
+    uint8_t buttons;
+    uint8_t chordButtons;               // held for a chord, kept out of the report until released
+
+    uint32_t startPressTime;
+    uint32_t selectPressTime;
+    uint32_t nextHostPressTime;
+    uint32_t addHostPressTime;
+    bool nextHostChordHeld;
+    bool addHostChordHeld;
+};
+
+#endif // NES_CONTROLLER_H
@@ -0,0 +1,75 @@
+// SleepManager.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifndef SLEEP_MANAGER_H
+#define SLEEP_MANAGER_H
+
+#include <Arduino.h>
+#include "BLEJoystick.h"
+#include "EnergyMonitor.h"
+
+class SleepManager {
+public:
+    // Marks RTC memory written by a deliberate sleep
+    static const uint32_t RETAINED_MAGIC = 0x4E455331;  // "NES1"
+
+    // Wait for the wake button to be released before sleeping, or it would wake at once
+    static const uint32_t RELEASE_TIMEOUT = 2000;       // milliseconds
+
+    // Standby current model, the awake share is measured per wake
+    static const uint32_t AWAKE_CURRENT = 22000;        // microamps, CPU running, radio idle
+    static const uint32_t LIGHT_SLEEP_CURRENT = 250;    // microamps, light sleep with the BLE controller up
+
+    // State carried across deep sleep in RTC memory
+    struct RetainedState {
+        uint32_t magic;
+        uint32_t sleepCount;
+        int64_t sleepStartTime;         // RTC clock, microseconds
+        uint8_t batteryLevel;
+        BLEJoystick::RetainedState link;
+        EnergyMonitor::RetainedState energy;
+    };
+
+    // Constructor, the pad is woken through its shift register latch and data lines
+    SleepManager(uint8_t latchPin, uint8_t dataPin);
+
+    // Wake methods
+    void begin();                       // call first in setup(), releases pins held through sleep
+    bool isWake() const;                // woken from deep sleep with retained state
+    esp_sleep_wakeup_cause_t getWakeCause() const;
+    uint32_t getSleepCount() const;
+    uint32_t getSleepDuration() const;  // milliseconds of the last sleep
+    RetainedState& getRetainedState();
+
+    // Sleep methods
+    void setTimerWake(uint32_t seconds);    // 0 = wake on button press only
+    void deepSleep();                   // does not return
+    bool lightSleep(uint32_t milliseconds);     // false if the sleep was rejected
+
+    // Standby statistics
+    void beginStandby();
+    void endStandby();
+    uint32_t getStandbyWakes() const;
+    uint32_t getStandbyAwakeTime() const;   // average microseconds awake per wake
+    uint32_t getStandbyCurrent() const;     // average microamps over standby
+    void printStandbyStats() const;
+
+private:
+    uint8_t latchPin;
+    uint8_t dataPin;
+    uint32_t timerWake;
+    esp_sleep_wakeup_cause_t wakeCause;
+    bool wake;
+    uint32_t sleepDuration;
+
+    // Standby statistics
+    int64_t standbyStartTime;           // esp_timer clock, microseconds
+    uint64_t standbyTime;               // microseconds
+    uint64_t standbySleepTime;          // microseconds in light sleep
+    uint32_t standbyWakes;
+
+    static int64_t rtcTime();
+};
+
+#endif // SLEEP_MANAGER_H
@@ -0,0 +1,123 @@
+// Arduino.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "Arduino.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+HardwareSerial Serial;
+
+// Read the monotonic clock in microseconds
+static uint64_t monotonicMicros() {
+    static uint64_t start = 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t micros = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    if (start == 0) {
+        start = micros;
+    }
+    return micros - start;
+}
+
+// Nothing to open on the host
+void HardwareSerial::begin(unsigned long) {
+}
+
+// Flush stdout
+void HardwareSerial::flush() {
+    fflush(stdout);
+}
+
+// No console input on the host
+int HardwareSerial::available() {
+    return 0;
+}
+
+// No console input on the host
+int HardwareSerial::read() {
+    return -1;
+}
+
+size_t HardwareSerial::print(const char* text) {
+    return muted ? 0 : fputs(text, stdout) >= 0 ? strlen(text) : 0;
+}
+
+size_t HardwareSerial::print(const std::string& text) {
+    return print(text.c_str());
+}
+
+size_t HardwareSerial::print(char c) {
+    return muted ? 0 : putchar(c) != EOF;
+}
+
+size_t HardwareSerial::print(long value, int base) {
+    if (base == DEC) {
+        return printf("%ld", value);
+    }
+    return print((unsigned long)value, base);
+}
+
+size_t HardwareSerial::print(unsigned long value, int base) {
+    return base == HEX ? printf("%lX", value) : printf("%lu", value);
+}
+
+size_t HardwareSerial::print(int value, int base) {
+    return print((long)value, base);
+}
+
+size_t HardwareSerial::print(unsigned int value, int base) {
+    return print((unsigned long)value, base);
+}
+
+size_t HardwareSerial::print(unsigned char value, int base) {
+    return print((unsigned long)value, base);
+}
+
+size_t HardwareSerial::print(double value, int digits) {
+    return printf("%.*f", digits, value);
+}
+
+size_t HardwareSerial::println() {
+    return print("\r\n");
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+    if (muted) {
+        return 0;
+    }
+    va_list args;
+    va_start(args, format);
+    int length = vprintf(format, args);
+    va_end(args);
+    return length > 0 ? length : 0;
+}
+
+// Drop or restore output
+void HardwareSerial::setMuted(bool muted) {
+    this->muted = muted;
+}
+
+// Get milliseconds since the first clock read
+unsigned long millis() {
+    return monotonicMicros() / 1000;
+}
+
+// Get microseconds since the first clock read
+unsigned long micros() {
+    return monotonicMicros();
+}
+
+// Wait
+void delay(unsigned long milliseconds) {
+    struct timespec duration = { (time_t)(milliseconds / 1000), (long)(milliseconds % 1000) * 1000000 };
+    nanosleep(&duration, nullptr);
+}
+
+// Busy wait like the target does
+void delayMicroseconds(unsigned int microseconds) {
+    uint64_t end = monotonicMicros() + microseconds;
+    while (monotonicMicros() < end) {
+    }
+}
@@ -0,0 +1,67 @@
+// Arduino.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// Host stand-in for the parts of the Arduino core used by the BLE code,
+// so it can be built and exercised on Linux with the NimBLE fake.
+
+#ifndef ARDUINO_FAKE_H
+#define ARDUINO_FAKE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <algorithm>
+
+#define HIGH 1
+#define LOW 0
+#define DEC 10
+#define HEX 16
+
+using std::min;
+using std::max;
+
+// Serial console on stdout
+class HardwareSerial {
+public:
+    void begin(unsigned long baud);
+    void flush();
+    int available();
+    int read();
+
+    size_t print(const char* text);
+    size_t print(const std::string& text);
+    size_t print(char c);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(unsigned char value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    size_t println();
+    template<class T> size_t println(T value) {
+        return print(value) + println();
+    }
+    template<class T> size_t println(T value, int format) {
+        return print(value, format) + println();
+    }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Host only: drop output, so benchmarks time the firmware rather than the terminal
+    void setMuted(bool muted);
+
+private:
+    bool muted = false;
+};
+
+extern HardwareSerial Serial;
+
+// Clock, from the first call
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long milliseconds);
+void delayMicroseconds(unsigned int microseconds);
+
+#endif // ARDUINO_FAKE_H
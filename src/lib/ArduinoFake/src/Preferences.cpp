@@ -0,0 +1,140 @@
+// Preferences.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "Preferences.h"
+#include <string.h>
+#include <map>
+#include <vector>
+
+// Every namespace, keyed by "namespace/key"
+static std::map<std::string, std::vector<uint8_t>>& storage() {
+    static std::map<std::string, std::vector<uint8_t>> entries;
+    return entries;
+}
+
+// Open a namespace
+bool Preferences::begin(const char* name, bool readOnly, const char*) {
+    this->name = name;
+    this->readOnly = readOnly;
+    open = true;
+    return true;
+}
+
+// Close the namespace
+void Preferences::end() {
+    open = false;
+}
+
+// Remove every key of the namespace
+bool Preferences::clear() {
+    if (!open || readOnly) {
+        return false;
+    }
+    std::string prefix = name + "/";
+    auto& entries = storage();
+    for (auto it = entries.begin(); it != entries.end();) {
+        it = it->first.compare(0, prefix.size(), prefix) == 0 ? entries.erase(it) : std::next(it);
+    }
+    return true;
+}
+
+// Remove a key
+bool Preferences::remove(const char* key) {
+    return open && !readOnly && storage().erase(path(key)) > 0;
+}
+
+// Check if a key exists
+bool Preferences::isKey(const char* key) {
+    return open && storage().count(path(key)) > 0;
+}
+
+size_t Preferences::putUChar(const char* key, uint8_t value) {
+    return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putUShort(const char* key, uint16_t value) {
+    return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+    return put(key, &value, sizeof(value));
+}
+
+size_t Preferences::putBool(const char* key, bool value) {
+    uint8_t byte = value;
+    return put(key, &byte, sizeof(byte));
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+    return put(key, value, length);
+}
+
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue) {
+    uint8_t value = defaultValue;
+    get(key, &value, sizeof(value));
+    return value;
+}
+
+uint16_t Preferences::getUShort(const char* key, uint16_t defaultValue) {
+    uint16_t value = defaultValue;
+    get(key, &value, sizeof(value));
+    return value;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+    uint32_t value = defaultValue;
+    get(key, &value, sizeof(value));
+    return value;
+}
+
+bool Preferences::getBool(const char* key, bool defaultValue) {
+    uint8_t value = defaultValue;
+    get(key, &value, sizeof(value));
+    return value != 0;
+}
+
+// Get the stored length of a key, 0 if missing
+size_t Preferences::getBytesLength(const char* key) {
+    auto it = storage().find(path(key));
+    return open && it != storage().end() ? it->second.size() : 0;
+}
+
+// Copy out a stored blob, 0 if missing or larger than the buffer
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength) {
+    size_t length = getBytesLength(key);
+    if (length == 0 || length > maxLength) {
+        return 0;
+    }
+    return get(key, buffer, length);
+}
+
+// Wipe every namespace
+void Preferences::eraseAll() {
+    storage().clear();
+}
+
+// Full key within the namespace
+std::string Preferences::path(const char* key) const {
+    return name + "/" + key;
+}
+
+// Store a value
+size_t Preferences::put(const char* key, const void* value, size_t length) {
+    if (!open || readOnly) {
+        return 0;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    storage()[path(key)].assign(bytes, bytes + length);
+    return length;
+}
+
+// Load a value of exactly the stored length
+size_t Preferences::get(const char* key, void* buffer, size_t length) {
+    auto it = storage().find(path(key));
+    if (!open || it == storage().end() || it->second.size() != length) {
+        return 0;
+    }
+    memcpy(buffer, it->second.data(), length);
+    return length;
+}
@@ -0,0 +1,50 @@
+// Preferences.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// Host stand-in for the ESP32 Preferences (NVS) library, kept in memory for
+// the life of the process.
+
+#ifndef PREFERENCES_FAKE_H
+#define PREFERENCES_FAKE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+    void end();
+
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putUChar(const char* key, uint8_t value);
+    size_t putUShort(const char* key, uint16_t value);
+    size_t putUInt(const char* key, uint32_t value);
+    size_t putBool(const char* key, bool value);
+    size_t putBytes(const char* key, const void* value, size_t length);
+
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0);
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    bool getBool(const char* key, bool defaultValue = false);
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buffer, size_t maxLength);
+
+    // Host only: wipe every namespace, like erasing the NVS partition
+    static void eraseAll();
+
+private:
+    std::string name;
+    bool open = false;
+    bool readOnly = false;
+
+    std::string path(const char* key) const;
+    size_t put(const char* key, const void* value, size_t length);
+    size_t get(const char* key, void* buffer, size_t length);
+};
+
+#endif // PREFERENCES_FAKE_H
@@ -0,0 +1,148 @@
+// NimBLEAdvertising.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "NimBLEDevice.h"
+#include <Arduino.h>
+
+// AD types
+static const uint8_t AD_FLAGS = 0x01;
+static const uint8_t AD_COMPLETE_16 = 0x03;
+static const uint8_t AD_COMPLETE_128 = 0x07;
+static const uint8_t AD_COMPLETE_NAME = 0x09;
+static const uint8_t AD_APPEARANCE = 0x19;
+
+// Add the flags structure
+void NimBLEAdvertisementData::setFlags(uint8_t flags) {
+    addData(std::string{ 2, (char)AD_FLAGS, (char)flags });
+}
+
+// Add the appearance structure
+void NimBLEAdvertisementData::setAppearance(uint16_t appearance) {
+    addData(std::string{ 3, (char)AD_APPEARANCE, (char)(appearance & 0xFF), (char)(appearance >> 8) });
+}
+
+// Add a complete service UUID list with one UUID
+void NimBLEAdvertisementData::setCompleteServices(const NimBLEUUID& uuid) {
+    // The text form is most significant byte first, the payload least significant first
+    std::string hex;
+    for (char c : uuid.toString().substr(uuid.bitSize() == 16 ? 2 : 0)) {
+        if (c != '-') {
+            hex += c;
+        }
+    }
+    std::string data{ (char)(hex.size() / 2 + 1), (char)(uuid.bitSize() == 16 ? AD_COMPLETE_16 : AD_COMPLETE_128) };
+    for (size_t i = hex.size(); i >= 2; i -= 2) {
+        data += (char)strtoul(hex.substr(i - 2, 2).c_str(), nullptr, 16);
+    }
+    addData(data);
+}
+
+// Add the complete name structure
+void NimBLEAdvertisementData::setName(const std::string& name) {
+    addData(std::string{ (char)(name.size() + 1), (char)AD_COMPLETE_NAME } + name);
+}
+
+// Append raw AD structures
+void NimBLEAdvertisementData::addData(const std::string& data) {
+    payload += data;
+}
+
+void NimBLEAdvertisementData::addData(char* data, size_t length) {
+    payload.append(data, length);
+}
+
+// Get the payload
+std::string NimBLEAdvertisementData::getPayload() {
+    return payload;
+}
+
+// Constructor
+NimBLEAdvertising::NimBLEAdvertising() {
+    type = BLE_GAP_CONN_MODE_UND;
+    minInterval = 0;
+    maxInterval = 0;
+    scanResponse = true;
+    advertising = false;
+    startTime = 0;
+    duration = 0;
+    completeCallback = nullptr;
+}
+
+void NimBLEAdvertising::setAdvertisementType(uint8_t type) {
+    this->type = type;
+}
+
+void NimBLEAdvertising::setMinInterval(uint16_t interval) {
+    minInterval = interval;
+}
+
+void NimBLEAdvertising::setMaxInterval(uint16_t interval) {
+    maxInterval = interval;
+}
+
+void NimBLEAdvertising::setScanResponse(bool enabled) {
+    scanResponse = enabled;
+}
+
+void NimBLEAdvertising::setAdvertisementData(NimBLEAdvertisementData& data) {
+    advPayload = data.getPayload();
+}
+
+void NimBLEAdvertising::setScanResponseData(NimBLEAdvertisementData& data) {
+    scanResponsePayload = data.getPayload();
+}
+
+// Start advertising, the duration is in seconds as in NimBLE-Arduino 1.4 and runs out in
+// NimBLEFake::runHostTasks()
+bool NimBLEAdvertising::start(uint32_t duration, void (*advCompleteCB)(NimBLEAdvertising* pAdvertising),
+                              NimBLEAddress* dirAddr) {
+    if (!NimBLEDevice::getInitialized() || (type == BLE_GAP_CONN_MODE_DIR && dirAddr == nullptr)) {
+        return false;
+    }
+
+    this->duration = duration;
+    this->dirAddr = dirAddr != nullptr ? *dirAddr : NimBLEAddress();
+    completeCallback = advCompleteCB;
+    startTime = millis();
+    advertising = true;
+    return true;
+}
+
+// Stop advertising, without the completion callback
+bool NimBLEAdvertising::stop() {
+    advertising = false;
+    return true;
+}
+
+bool NimBLEAdvertising::isAdvertising() {
+    return advertising;
+}
+
+uint8_t NimBLEAdvertising::getAdvertisementType() const {
+    return type;
+}
+
+uint16_t NimBLEAdvertising::getMinInterval() const {
+    return minInterval;
+}
+
+uint16_t NimBLEAdvertising::getMaxInterval() const {
+    return maxInterval;
+}
+
+uint32_t NimBLEAdvertising::getDuration() const {
+    return duration;
+}
+
+const NimBLEAddress& NimBLEAdvertising::getDirectedAddress() const {
+    return dirAddr;
+}
+
+const std::string& NimBLEAdvertising::getAdvertisementPayload() const {
+    return advPayload;
+}
+
+const std::string& NimBLEAdvertising::getScanResponsePayload() const {
+    return scanResponsePayload;
+}
@@ -0,0 +1,321 @@
+// NimBLEDevice.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "NimBLEDevice.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+// Fixed public address of the simulated device
+static const uint8_t DEVICE_ADDRESS[6] = { 0x01, 0x00, 0x5E, 0x53, 0x45, 0x4E };
+
+bool NimBLEDevice::initialized = false;
+std::string NimBLEDevice::deviceName;
+NimBLEServer* NimBLEDevice::pServer = nullptr;
+NimBLEAdvertising* NimBLEDevice::pAdvertising = nullptr;
+gap_event_handler NimBLEDevice::customGapHandler = nullptr;
+esp_power_level_t NimBLEDevice::powerLevel = ESP_PWR_LVL_P9;
+uint8_t NimBLEDevice::securityAuth = 0;
+uint8_t NimBLEDevice::securityIOCap = BLE_HS_IO_NO_INPUT_OUTPUT;
+std::vector<NimBLEAddress> NimBLEDevice::bonds;
+
+// Start the stack
+void NimBLEDevice::init(const std::string& deviceName) {
+    NimBLEDevice::deviceName = deviceName;
+    initialized = true;
+}
+
+// Stop the stack, optionally deleting the server and advertising objects
+void NimBLEDevice::deinit(bool clearAll) {
+    initialized = false;
+    if (clearAll) {
+        delete pServer;
+        pServer = nullptr;
+        delete pAdvertising;
+        pAdvertising = nullptr;
+        customGapHandler = nullptr;
+    }
+}
+
+// Check if the stack was started
+bool NimBLEDevice::getInitialized() {
+    return initialized;
+}
+
+// Get the GAP device name
+std::string NimBLEDevice::getDeviceName() {
+    return deviceName;
+}
+
+// Get the device address
+NimBLEAddress NimBLEDevice::getAddress() {
+    return NimBLEAddress(DEVICE_ADDRESS);
+}
+
+// Create the server, there is only one
+NimBLEServer* NimBLEDevice::createServer() {
+    if (pServer == nullptr) {
+        pServer = new NimBLEServer();
+    }
+    return pServer;
+}
+
+// Get the server, nullptr until created
+NimBLEServer* NimBLEDevice::getServer() {
+    return pServer;
+}
+
+// Get the advertising object, created on first use
+NimBLEAdvertising* NimBLEDevice::getAdvertising() {
+    if (pAdvertising == nullptr) {
+        pAdvertising = new NimBLEAdvertising();
+    }
+    return pAdvertising;
+}
+
+// Start advertising with the current settings
+void NimBLEDevice::startAdvertising() {
+    getAdvertising()->start();
+}
+
+// Stop advertising
+void NimBLEDevice::stopAdvertising() {
+    getAdvertising()->stop();
+}
+
+// Set the pairing requirements
+void NimBLEDevice::setSecurityAuth(uint8_t authReq) {
+    securityAuth = authReq;
+}
+
+// Set the pairing requirements
+void NimBLEDevice::setSecurityAuth(bool bonding, bool mitm, bool sc) {
+    securityAuth = (bonding ? BLE_SM_PAIR_AUTHREQ_BOND : 0) | (mitm ? BLE_SM_PAIR_AUTHREQ_MITM : 0) |
+                   (sc ? BLE_SM_PAIR_AUTHREQ_SC : 0);
+}
+
+// Set the pairing IO capabilities
+void NimBLEDevice::setSecurityIOCap(uint8_t ioCap) {
+    securityIOCap = ioCap;
+}
+
+// Set the TX power level, one level for every power type
+void NimBLEDevice::setPower(esp_power_level_t powerLevel, esp_ble_power_type_t) {
+    NimBLEDevice::powerLevel = powerLevel;
+}
+
+// Get the TX power in dBm
+int NimBLEDevice::getPower(esp_ble_power_type_t) {
+    return -24 + 3 * powerLevel;
+}
+
+// Register the handler that sees every GAP event before the server
+bool NimBLEDevice::setCustomGapHandler(gap_event_handler handler) {
+    customGapHandler = handler;
+    return true;
+}
+
+// Get the number of bonded hosts
+int NimBLEDevice::getNumBonds() {
+    return bonds.size();
+}
+
+// Check if a host is bonded
+bool NimBLEDevice::isBonded(const NimBLEAddress& address) {
+    return std::find(bonds.begin(), bonds.end(), address) != bonds.end();
+}
+
+// Delete the bond of a host
+bool NimBLEDevice::deleteBond(const NimBLEAddress& address) {
+    auto it = std::find(bonds.begin(), bonds.end(), address);
+    if (it == bonds.end()) {
+        return false;
+    }
+    bonds.erase(it);
+    return true;
+}
+
+// Delete every bond
+bool NimBLEDevice::deleteAllBonds() {
+    bonds.clear();
+    return true;
+}
+
+// Get a bonded host address, oldest first
+NimBLEAddress NimBLEDevice::getBondedAddress(int index) {
+    return index >= 0 && index < (int)bonds.size() ? bonds[index] : NimBLEAddress();
+}
+
+// Address constructors
+NimBLEAddress::NimBLEAddress() {
+    memset(&address, 0, sizeof(address));
+}
+
+NimBLEAddress::NimBLEAddress(ble_addr_t address) : address(address) {}
+
+NimBLEAddress::NimBLEAddress(const uint8_t address[6], uint8_t type) {
+    this->address.type = type;
+    memcpy(this->address.val, address, sizeof(this->address.val));
+}
+
+// Parse "aa:bb:cc:dd:ee:ff", most significant byte first
+NimBLEAddress::NimBLEAddress(const std::string& address, uint8_t type) {
+    unsigned int bytes[6] = {};
+    this->address.type = type;
+    sscanf(address.c_str(), "%2x:%2x:%2x:%2x:%2x:%2x", &bytes[5], &bytes[4], &bytes[3], &bytes[2], &bytes[1],
+           &bytes[0]);
+    for (uint8_t i = 0; i < 6; i++) {
+        this->address.val[i] = bytes[i];
+    }
+}
+
+// Get the address bytes
+const uint8_t* NimBLEAddress::getNative() const {
+    return address.val;
+}
+
+// Get the address type
+uint8_t NimBLEAddress::getType() const {
+    return address.type;
+}
+
+// Format as "aa:bb:cc:dd:ee:ff"
+std::string NimBLEAddress::toString() const {
+    char text[18];
+    snprintf(text, sizeof(text), "%02x:%02x:%02x:%02x:%02x:%02x", address.val[5], address.val[4], address.val[3],
+             address.val[2], address.val[1], address.val[0]);
+    return text;
+}
+
+// Compare addresses, type included
+bool NimBLEAddress::equals(const NimBLEAddress& other) const {
+    return address.type == other.address.type && memcmp(address.val, other.address.val, sizeof(address.val)) == 0;
+}
+
+bool NimBLEAddress::operator==(const NimBLEAddress& other) const {
+    return equals(other);
+}
+
+bool NimBLEAddress::operator!=(const NimBLEAddress& other) const {
+    return !equals(other);
+}
+
+// UUID constructors
+NimBLEUUID::NimBLEUUID() : size(0) {
+    memset(value, 0, sizeof(value));
+}
+
+NimBLEUUID::NimBLEUUID(uint16_t uuid) : size(16) {
+    memset(value, 0, sizeof(value));
+    value[0] = uuid & 0xFF;
+    value[1] = uuid >> 8;
+}
+
+NimBLEUUID::NimBLEUUID(const char* uuid) : NimBLEUUID(std::string(uuid)) {}
+
+// Parse "0x1812", "1812" or a 128-bit UUID with dashes
+NimBLEUUID::NimBLEUUID(const std::string& uuid) : NimBLEUUID() {
+    std::string digits;
+    for (char c : uuid.compare(0, 2, "0x") == 0 ? uuid.substr(2) : uuid) {
+        if (c != '-') {
+            digits += c;
+        }
+    }
+    if (digits.size() != 4 && digits.size() != 32) {
+        return;
+    }
+
+    size = digits.size() == 4 ? 16 : 128;
+    for (size_t i = 0; i < digits.size() / 2; i++) {
+        value[digits.size() / 2 - 1 - i] = strtoul(digits.substr(i * 2, 2).c_str(), nullptr, 16);
+    }
+}
+
+// Get the UUID size in bits
+uint8_t NimBLEUUID::bitSize() const {
+    return size;
+}
+
+// Format as "0x1812" or a 128-bit UUID with dashes
+std::string NimBLEUUID::toString() const {
+    char text[37];
+    if (size == 16) {
+        snprintf(text, sizeof(text), "0x%02x%02x", value[1], value[0]);
+        return text;
+    }
+
+    char* out = text;
+    for (int i = 15; i >= 0; i--) {
+        out += sprintf(out, "%02x", value[i]);
+        if (i == 12 || i == 10 || i == 8 || i == 6) {
+            *out++ = '-';
+        }
+    }
+    return text;
+}
+
+bool NimBLEUUID::operator==(const NimBLEUUID& other) const {
+    return size == other.size && memcmp(value, other.value, sizeof(value)) == 0;
+}
+
+bool NimBLEUUID::operator!=(const NimBLEUUID& other) const {
+    return !(*this == other);
+}
+
+// Connection information, a copy of the GAP descriptor
+NimBLEConnInfo::NimBLEConnInfo(const ble_gap_conn_desc& desc) : desc(desc) {}
+
+NimBLEAddress NimBLEConnInfo::getAddress() const {
+    return NimBLEAddress(desc.peer_ota_addr);
+}
+
+NimBLEAddress NimBLEConnInfo::getIdAddress() const {
+    return NimBLEAddress(desc.peer_id_addr);
+}
+
+uint16_t NimBLEConnInfo::getConnHandle() const {
+    return desc.conn_handle;
+}
+
+uint16_t NimBLEConnInfo::getConnInterval() const {
+    return desc.conn_itvl;
+}
+
+uint16_t NimBLEConnInfo::getConnLatency() const {
+    return desc.conn_latency;
+}
+
+uint16_t NimBLEConnInfo::getConnTimeout() const {
+    return desc.supervision_timeout;
+}
+
+bool NimBLEConnInfo::isEncrypted() const {
+    return desc.sec_state.encrypted;
+}
+
+bool NimBLEConnInfo::isBonded() const {
+    return desc.sec_state.bonded;
+}
+
+// Attribute value constructors
+NimBLEAttValue::NimBLEAttValue() {}
+
+NimBLEAttValue::NimBLEAttValue(const uint8_t* data, size_t length) : value(data, data + length) {}
+
+const uint8_t* NimBLEAttValue::data() const {
+    return value.data();
+}
+
+size_t NimBLEAttValue::size() const {
+    return value.size();
+}
+
+size_t NimBLEAttValue::length() const {
+    return value.size();
+}
+
+// Get a byte, 0 past the end
+uint8_t NimBLEAttValue::operator[](size_t index) const {
+    return index < value.size() ? value[index] : 0;
+}
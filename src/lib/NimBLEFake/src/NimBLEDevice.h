@@ -0,0 +1,552 @@
+// NimBLEDevice.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// Host stand-in for the part of the NimBLE-Arduino 1.4 API that BLEJoystick
+// uses. There is no radio: GATT server objects keep their values, host events
+// are injected through NimBLEFake and notifications are recorded there.
+
+#ifndef NIMBLE_DEVICE_FAKE_H
+#define NIMBLE_DEVICE_FAKE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+// ---- NimBLE host constants ----
+
+#define BLE_HS_CONN_HANDLE_NONE 0xFFFF
+
+// Host error codes
+#define BLE_HS_EINVAL 3
+#define BLE_HS_ENOMEM 6
+#define BLE_HS_ENOTCONN 7
+#define BLE_HS_EDONE 14
+#define BLE_HS_EBUSY 15
+#define BLE_HS_ERR_HCI_BASE 0x200
+
+// HCI reasons
+#define BLE_ERR_CONN_SPVN_TMO 0x08
+#define BLE_ERR_REM_USER_CONN_TERM 0x13
+#define BLE_ERR_CONN_TERM_LOCAL 0x16
+
+// Security
+#define BLE_SM_PAIR_AUTHREQ_BOND 0x01
+#define BLE_SM_PAIR_AUTHREQ_MITM 0x04
+#define BLE_SM_PAIR_AUTHREQ_SC 0x08
+#define BLE_HS_IO_NO_INPUT_OUTPUT 0x03
+
+// GAP events
+#define BLE_GAP_EVENT_CONNECT 0
+#define BLE_GAP_EVENT_DISCONNECT 1
+#define BLE_GAP_EVENT_CONN_UPDATE 3
+#define BLE_GAP_EVENT_ADV_COMPLETE 9
+#define BLE_GAP_EVENT_ENC_CHANGE 10
+#define BLE_GAP_EVENT_NOTIFY_TX 13
+#define BLE_GAP_EVENT_SUBSCRIBE 14
+#define BLE_GAP_EVENT_REPEAT_PAIRING 17
+#define BLE_GAP_EVENT_PHY_UPDATE_COMPLETE 18
+#define BLE_GAP_SUBSCRIBE_REASON_WRITE 1
+#define BLE_GAP_SUBSCRIBE_REASON_TERM 2
+#define BLE_GAP_SUBSCRIBE_REASON_RESTORE 3
+#define BLE_GAP_ROLE_SLAVE 1
+
+// PHYs
+#define BLE_GAP_LE_PHY_1M 1
+#define BLE_GAP_LE_PHY_2M 2
+#define BLE_GAP_LE_PHY_CODED 3
+#define BLE_GAP_LE_PHY_1M_MASK 0x01
+#define BLE_GAP_LE_PHY_2M_MASK 0x02
+#define BLE_GAP_LE_PHY_CODED_MASK 0x04
+#define BLE_GAP_LE_PHY_CODED_ANY 0
+
+// Advertising
+#define BLE_GAP_CONN_MODE_NON 0
+#define BLE_GAP_CONN_MODE_DIR 1
+#define BLE_GAP_CONN_MODE_UND 2
+#define BLE_HS_ADV_F_DISC_GEN 0x02
+#define BLE_HS_ADV_F_BREDR_UNSUP 0x04
+#define BLE_ADDR_PUBLIC 0
+#define BLE_ADDR_RANDOM 1
+#define HID_GAMEPAD 0x03C4
+
+// ---- NimBLE host C API subset ----
+
+typedef struct {
+    uint8_t type;
+    uint8_t val[6];
+} ble_addr_t;
+
+struct ble_gap_sec_state {
+    unsigned encrypted:1;
+    unsigned authenticated:1;
+    unsigned bonded:1;
+    unsigned key_size:5;
+};
+
+struct ble_gap_conn_desc {
+    struct ble_gap_sec_state sec_state;
+    ble_addr_t our_id_addr;
+    ble_addr_t peer_id_addr;
+    ble_addr_t our_ota_addr;
+    ble_addr_t peer_ota_addr;
+    uint16_t conn_handle;
+    uint16_t conn_itvl;
+    uint16_t conn_latency;
+    uint16_t supervision_timeout;
+    uint8_t role;
+    uint8_t master_clock_accuracy;
+};
+
+struct ble_gap_upd_params {
+    uint16_t itvl_min;
+    uint16_t itvl_max;
+    uint16_t latency;
+    uint16_t supervision_timeout;
+    uint16_t min_ce_len;
+    uint16_t max_ce_len;
+};
+
+struct ble_gap_event {
+    uint8_t type;
+    union {
+        struct { int status; uint16_t conn_handle; } connect;
+        struct { int reason; struct ble_gap_conn_desc conn; } disconnect;
+        struct { int status; uint16_t conn_handle; } conn_update;
+        struct { int reason; } adv_complete;
+        struct { int status; uint16_t conn_handle; } enc_change;
+        struct { int status; uint16_t conn_handle; uint16_t attr_handle; uint8_t indication:1; } notify_tx;
+        struct {
+            uint16_t conn_handle;
+            uint16_t attr_handle;
+            uint8_t reason;
+            uint8_t prev_notify:1;
+            uint8_t cur_notify:1;
+            uint8_t prev_indicate:1;
+            uint8_t cur_indicate:1;
+        } subscribe;
+        struct { int status; uint16_t conn_handle; uint8_t tx_phy; uint8_t rx_phy; } phy_updated;
+    };
+};
+
+typedef int (*gap_event_handler)(ble_gap_event* event, void* arg);
+
+// Host buffer, from a fixed pool sized with NimBLEFake::setTxBuffers()
+struct os_mbuf;
+
+struct ble_sm_sc_oob_data {
+    uint8_t r[16];
+    uint8_t c[16];
+};
+
+extern "C" {
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc* out_desc);
+int ble_gap_conn_rssi(uint16_t conn_handle, int8_t* out_rssi);
+int ble_gap_terminate(uint16_t conn_handle, uint8_t hci_reason);
+int ble_gap_update_params(uint16_t conn_handle, const struct ble_gap_upd_params* params);
+int ble_gap_read_le_phy(uint16_t conn_handle, uint8_t* tx_phy, uint8_t* rx_phy);
+int ble_gap_set_prefered_le_phy(uint16_t conn_handle, uint8_t tx_phys_mask, uint8_t rx_phys_mask, uint16_t phy_opts);
+int ble_gap_set_prefered_default_le_phy(uint8_t tx_phys_mask, uint8_t rx_phys_mask);
+int ble_hs_hci_util_set_data_len(uint16_t conn_handle, uint16_t tx_octets, uint16_t tx_time);
+struct os_mbuf* ble_hs_mbuf_from_flat(const void* buf, uint16_t len);
+int ble_gattc_notify_custom(uint16_t conn_handle, uint16_t att_handle, struct os_mbuf* om);
+int os_msys_num_free(void);
+int ble_sm_sc_oob_generate_data(struct ble_sm_sc_oob_data* oob_data);
+}
+
+// ---- ESP32-C3 controller TX power ----
+
+typedef enum {
+    ESP_PWR_LVL_N24 = 0,
+    ESP_PWR_LVL_N21,
+    ESP_PWR_LVL_N18,
+    ESP_PWR_LVL_N15,
+    ESP_PWR_LVL_N12,
+    ESP_PWR_LVL_N9,
+    ESP_PWR_LVL_N6,
+    ESP_PWR_LVL_N3,
+    ESP_PWR_LVL_N0,
+    ESP_PWR_LVL_P3,
+    ESP_PWR_LVL_P6,
+    ESP_PWR_LVL_P9,
+    ESP_PWR_LVL_P12,
+    ESP_PWR_LVL_P15,
+    ESP_PWR_LVL_P18,
+    ESP_PWR_LVL_P21,
+} esp_power_level_t;
+
+typedef enum {
+    ESP_BLE_PWR_TYPE_CONN_HDL0 = 0,
+    ESP_BLE_PWR_TYPE_ADV = 9,
+    ESP_BLE_PWR_TYPE_SCAN = 10,
+    ESP_BLE_PWR_TYPE_DEFAULT = 11,
+} esp_ble_power_type_t;
+
+// ---- NimBLE-Arduino API subset ----
+
+class NimBLEServer;
+class NimBLEService;
+class NimBLECharacteristic;
+class NimBLEAdvertising;
+
+class NimBLEAddress {
+public:
+    NimBLEAddress();
+    NimBLEAddress(ble_addr_t address);
+    NimBLEAddress(const uint8_t address[6], uint8_t type = BLE_ADDR_PUBLIC);
+    NimBLEAddress(const std::string& address, uint8_t type = BLE_ADDR_PUBLIC);
+
+    const uint8_t* getNative() const;   // least significant byte first
+    uint8_t getType() const;
+    std::string toString() const;
+    bool equals(const NimBLEAddress& other) const;
+    bool operator==(const NimBLEAddress& other) const;
+    bool operator!=(const NimBLEAddress& other) const;
+
+private:
+    ble_addr_t address;
+};
+
+class NimBLEUUID {
+public:
+    NimBLEUUID();
+    NimBLEUUID(uint16_t uuid);
+    NimBLEUUID(const char* uuid);
+    NimBLEUUID(const std::string& uuid);
+
+    uint8_t bitSize() const;            // 16 or 128, 0 when unset
+    std::string toString() const;
+    bool operator==(const NimBLEUUID& other) const;
+    bool operator!=(const NimBLEUUID& other) const;
+
+private:
+    uint8_t size;
+    uint8_t value[16];                  // least significant byte first
+};
+
+class NimBLEConnInfo {
+public:
+    NimBLEConnInfo(const ble_gap_conn_desc& desc);
+
+    NimBLEAddress getAddress() const;
+    NimBLEAddress getIdAddress() const;
+    uint16_t getConnHandle() const;
+    uint16_t getConnInterval() const;
+    uint16_t getConnLatency() const;
+    uint16_t getConnTimeout() const;
+    bool isEncrypted() const;
+    bool isBonded() const;
+
+private:
+    ble_gap_conn_desc desc;
+};
+
+class NimBLEAttValue {
+public:
+    NimBLEAttValue();
+    NimBLEAttValue(const uint8_t* data, size_t length);
+
+    const uint8_t* data() const;
+    size_t size() const;
+    size_t length() const;
+    uint8_t operator[](size_t index) const;
+
+private:
+    std::vector<uint8_t> value;
+};
+
+namespace NIMBLE_PROPERTY {
+    enum {
+        READ = 0x0002,
+        WRITE_NR = 0x0004,
+        WRITE = 0x0008,
+        NOTIFY = 0x0010,
+        INDICATE = 0x0020,
+        READ_ENC = 0x0200,
+        READ_AUTHEN = 0x0400,
+        WRITE_ENC = 0x1000,
+    };
+}
+
+class NimBLECharacteristicCallbacks {
+public:
+    typedef enum {
+        SUCCESS_INDICATE,
+        SUCCESS_NOTIFY,
+        ERROR_INDICATE_DISABLED,
+        ERROR_NOTIFY_DISABLED,
+        ERROR_GATT,
+        ERROR_NO_CLIENT,
+        ERROR_INDICATE_TIMEOUT,
+        ERROR_INDICATE_FAILURE,
+    } Status;
+
+    virtual ~NimBLECharacteristicCallbacks();
+    virtual void onRead(NimBLECharacteristic* pCharacteristic);
+    virtual void onRead(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc);
+    virtual void onWrite(NimBLECharacteristic* pCharacteristic);
+    virtual void onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc);
+    virtual void onNotify(NimBLECharacteristic* pCharacteristic);
+    virtual void onStatus(NimBLECharacteristic* pCharacteristic, Status status, int code);
+    virtual void onSubscribe(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc, uint16_t subValue);
+};
+
+class NimBLECharacteristic {
+public:
+    NimBLECharacteristic(const NimBLEUUID& uuid, uint32_t properties, NimBLEService* pService, uint16_t handle);
+    ~NimBLECharacteristic();
+
+    // Value methods
+    void setValue(const uint8_t* data, size_t length);
+    void setValue(const std::string& value);
+    void setValue(const char* value);
+    NimBLEAttValue getValue(time_t* timestamp = nullptr);
+
+    // Notification methods, to subscribed connections only
+    void notify(bool isNotification = true);
+    void notify(const uint8_t* value, size_t length, bool isNotification = true);
+    void indicate();
+    size_t getSubscribedCount();
+
+    void setCallbacks(NimBLECharacteristicCallbacks* pCallbacks);
+    NimBLECharacteristicCallbacks* getCallbacks();
+    uint16_t getHandle();               // value handle
+    uint32_t getProperties();
+    NimBLEUUID getUUID();
+    NimBLEService* getService();
+
+private:
+    friend class NimBLEServer;
+
+    NimBLEUUID uuid;
+    uint32_t properties;
+    NimBLEService* pService;
+    uint16_t handle;
+    std::vector<uint8_t> value;
+    NimBLECharacteristicCallbacks* pCallbacks;
+    std::vector<std::pair<uint16_t, uint16_t>> subscriptions;   // connection handle, CCCD value
+
+    void setSubscribe(uint16_t connHandle, uint16_t subValue);
+    void removeSubscription(uint16_t connHandle);
+};
+
+class NimBLEService {
+public:
+    NimBLEService(const NimBLEUUID& uuid, NimBLEServer* pServer, uint16_t handle);
+    ~NimBLEService();
+
+    NimBLECharacteristic* createCharacteristic(const char* uuid,
+                                               uint32_t properties = NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE,
+                                               uint16_t maxLength = 512);
+    NimBLECharacteristic* createCharacteristic(const NimBLEUUID& uuid,
+                                               uint32_t properties = NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE,
+                                               uint16_t maxLength = 512);
+    NimBLECharacteristic* getCharacteristic(const NimBLEUUID& uuid, uint16_t instanceId = 0);
+    NimBLECharacteristic* getCharacteristicByHandle(uint16_t handle);
+    bool start();
+    bool isStarted();
+    NimBLEUUID getUUID();
+    uint16_t getHandle();
+
+private:
+    friend class NimBLEServer;
+
+    NimBLEUUID uuid;
+    NimBLEServer* pServer;
+    uint16_t handle;
+    bool started;
+    std::vector<NimBLECharacteristic*> characteristics;
+};
+
+class NimBLEServerCallbacks {
+public:
+    virtual ~NimBLEServerCallbacks();
+    virtual void onConnect(NimBLEServer* pServer);
+    virtual void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc);
+    virtual void onDisconnect(NimBLEServer* pServer);
+    virtual void onDisconnect(NimBLEServer* pServer, ble_gap_conn_desc* desc);
+    virtual void onAuthenticationComplete(ble_gap_conn_desc* desc);
+};
+
+class NimBLEServer {
+public:
+    NimBLEServer();
+    ~NimBLEServer();
+
+    // GATT database methods
+    NimBLEService* createService(const char* uuid);
+    NimBLEService* createService(const NimBLEUUID& uuid);
+    NimBLEService* getServiceByUUID(const NimBLEUUID& uuid, uint16_t instanceId = 0);
+    void start();
+    bool isStarted();
+
+    // Connection methods
+    void setCallbacks(NimBLEServerCallbacks* pCallbacks, bool deleteCallbacks = true);
+    void advertiseOnDisconnect(bool enabled);
+    size_t getConnectedCount();
+    std::vector<uint16_t> getPeerDevices();
+    NimBLEConnInfo getPeerInfo(size_t index);
+    NimBLEConnInfo getPeerIDInfo(uint16_t connHandle);
+    int disconnect(uint16_t connHandle, uint8_t reason = BLE_ERR_REM_USER_CONN_TERM);
+    void updateConnParams(uint16_t connHandle, uint16_t minInterval, uint16_t maxInterval, uint16_t latency,
+                          uint16_t timeout);
+    void setDataLen(uint16_t connHandle, uint16_t txOctets);
+    NimBLEAdvertising* getAdvertising();
+    bool startAdvertising();
+    bool stopAdvertising();
+
+private:
+    friend class NimBLEFake;
+    friend class NimBLEService;
+
+    std::vector<NimBLEService*> services;
+    std::vector<uint16_t> peers;
+    NimBLEServerCallbacks* pCallbacks;
+    bool deleteCallbacks;
+    bool advertiseOnDisconnectEnabled;
+    bool started;
+    uint16_t nextHandle;
+
+    uint16_t allocateHandles(uint16_t count);
+    NimBLECharacteristic* findCharacteristic(uint16_t handle);
+    void handleGapEvent(ble_gap_event* event);
+};
+
+class NimBLEAdvertisementData {
+public:
+    void setFlags(uint8_t flags);
+    void setAppearance(uint16_t appearance);
+    void setCompleteServices(const NimBLEUUID& uuid);
+    void setName(const std::string& name);
+    void addData(const std::string& data);
+    void addData(char* data, size_t length);
+    std::string getPayload();
+
+private:
+    std::string payload;
+};
+
+class NimBLEAdvertising {
+public:
+    NimBLEAdvertising();
+
+    void setAdvertisementType(uint8_t type);
+    void setMinInterval(uint16_t interval);
+    void setMaxInterval(uint16_t interval);
+    void setScanResponse(bool enabled);
+    void setAdvertisementData(NimBLEAdvertisementData& data);
+    void setScanResponseData(NimBLEAdvertisementData& data);
+    bool start(uint32_t duration = 0, void (*advCompleteCB)(NimBLEAdvertising* pAdvertising) = nullptr,
+               NimBLEAddress* dirAddr = nullptr);
+    bool stop();
+    bool isAdvertising();
+
+    // Fake only: parameters of the advertising set
+    uint8_t getAdvertisementType() const;
+    uint16_t getMinInterval() const;
+    uint16_t getMaxInterval() const;
+    uint32_t getDuration() const;                   // seconds, 0 = until stopped
+    const NimBLEAddress& getDirectedAddress() const;
+    const std::string& getAdvertisementPayload() const;
+    const std::string& getScanResponsePayload() const;
+
+private:
+    friend class NimBLEFake;
+
+    uint8_t type;
+    uint16_t minInterval;
+    uint16_t maxInterval;
+    bool scanResponse;
+    std::string advPayload;
+    std::string scanResponsePayload;
+    bool advertising;
+    uint32_t startTime;
+    uint32_t duration;          // seconds
+    void (*completeCallback)(NimBLEAdvertising* pAdvertising);
+    NimBLEAddress dirAddr;
+};
+
+class NimBLEHIDDevice {
+public:
+    NimBLEHIDDevice(NimBLEServer* pServer);
+
+    void reportMap(uint8_t* map, uint16_t length);
+    void startServices();
+
+    // Services
+    NimBLEService* deviceInfo();
+    NimBLEService* hidService();
+    NimBLEService* batteryService();
+
+    // Characteristics
+    NimBLECharacteristic* manufacturer();
+    void pnp(uint8_t sig, uint16_t vid, uint16_t pid, uint16_t version);
+    void hidInfo(uint8_t country, uint8_t flags);
+    NimBLECharacteristic* hidControl();
+    NimBLECharacteristic* protocolMode();
+    NimBLECharacteristic* inputReport(uint8_t reportId);
+    NimBLECharacteristic* batteryLevel();
+    void setBatteryLevel(uint8_t level);
+
+private:
+    NimBLEService* pDeviceInfoService;
+    NimBLEService* pHidService;
+    NimBLEService* pBatteryService;
+    NimBLECharacteristic* pManufacturerCharacteristic;
+    NimBLECharacteristic* pPnpCharacteristic;
+    NimBLECharacteristic* pHidInfoCharacteristic;
+    NimBLECharacteristic* pReportMapCharacteristic;
+    NimBLECharacteristic* pHidControlCharacteristic;
+    NimBLECharacteristic* pProtocolModeCharacteristic;
+    NimBLECharacteristic* pBatteryLevelCharacteristic;
+};
+
+class NimBLEDevice {
+public:
+    static void init(const std::string& deviceName);
+    static void deinit(bool clearAll = false);
+    static bool getInitialized();
+    static std::string getDeviceName();
+    static NimBLEAddress getAddress();
+
+    static NimBLEServer* createServer();
+    static NimBLEServer* getServer();
+    static NimBLEAdvertising* getAdvertising();
+    static void startAdvertising();
+    static void stopAdvertising();
+
+    // Security
+    static void setSecurityAuth(uint8_t authReq);
+    static void setSecurityAuth(bool bonding, bool mitm, bool sc);
+    static void setSecurityIOCap(uint8_t ioCap);
+
+    // Radio
+    static void setPower(esp_power_level_t powerLevel, esp_ble_power_type_t powerType = ESP_BLE_PWR_TYPE_DEFAULT);
+    static int getPower(esp_ble_power_type_t powerType = ESP_BLE_PWR_TYPE_DEFAULT);   // dBm
+    static bool setCustomGapHandler(gap_event_handler handler);
+
+    // Bonds
+    static int getNumBonds();
+    static bool isBonded(const NimBLEAddress& address);
+    static bool deleteBond(const NimBLEAddress& address);
+    static bool deleteAllBonds();
+    static NimBLEAddress getBondedAddress(int index);
+
+private:
+    friend class NimBLEFake;
+
+    static bool initialized;
+    static std::string deviceName;
+    static NimBLEServer* pServer;
+    static NimBLEAdvertising* pAdvertising;
+    static gap_event_handler customGapHandler;
+    static esp_power_level_t powerLevel;
+    static uint8_t securityAuth;
+    static uint8_t securityIOCap;
+    static std::vector<NimBLEAddress> bonds;
+};
+
+#endif // NIMBLE_DEVICE_FAKE_H
@@ -0,0 +1,601 @@
+// NimBLEFake.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "NimBLEFake.h"
+#include "nimble/porting/nimble/include/nimble/nimble_port.h"
+#include "nimble/nimble/host/services/gatt/include/services/gatt/ble_svc_gatt.h"
+#include <Arduino.h>
+#include <string.h>
+#include <deque>
+#include <functional>
+#include <map>
+
+// Host buffer from the pool
+struct os_mbuf {
+    bool used;
+    uint16_t attrHandle;
+    uint16_t length;
+    uint8_t data[NimBLEFake::TX_BUFFER_SIZE];
+};
+
+// Simulated link to one host
+struct Connection {
+    ble_gap_conn_desc desc;
+    int8_t rssi;
+    uint8_t txPhy;
+    uint8_t rxPhy;
+    std::deque<os_mbuf*> pending;   // notifications held by a congested controller
+    bool stalled;                   // host stopped acknowledging, only completeTx() sends
+};
+
+// Fixed public address of the simulated device
+static const uint8_t OWN_ADDRESS[6] = { 0x01, 0x00, 0x5E, 0x53, 0x45, 0x4E };
+
+static std::map<uint16_t, Connection> connections;
+static std::map<std::string, std::vector<uint16_t>> storedCccds;  // bonded host -> attributes with notify on
+static uint16_t nextConnHandle = 1;
+static std::vector<os_mbuf> txBuffers(NimBLEFake::DEFAULT_TX_BUFFERS);
+static uint16_t freeTxBuffers = NimBLEFake::DEFAULT_TX_BUFFERS;
+static bool congested = false;
+static bool phy2M = true;
+static std::vector<NimBLEFake::Notification> notifications;
+static std::deque<ble_npl_event*> portEvents;
+static std::deque<std::function<void()>> deferredEvents;
+static uint16_t serviceChangedCount = 0;
+static uint16_t connParamsRequests = 0;
+static uint16_t phyRequests = 0;
+static ble_npl_eventq defaultEventq;
+
+// Find a live connection
+static Connection* findConnection(uint16_t connHandle) {
+    auto it = connections.find(connHandle);
+    return it != connections.end() ? &it->second : nullptr;
+}
+
+// Give a buffer back to the pool
+static void freeTxBuffer(os_mbuf* om) {
+    if (om->used) {
+        om->used = false;
+        freeTxBuffers++;
+    }
+}
+
+// Put a buffer on air: record it, free it and report the transmission
+static void transmit(uint16_t connHandle, os_mbuf* om) {
+    NimBLEFake::Notification notification;
+    notification.time = micros();
+    notification.connHandle = connHandle;
+    notification.attrHandle = om->attrHandle;
+    notification.value.assign(om->data, om->data + om->length);
+    notifications.push_back(notification);
+
+    uint16_t attrHandle = om->attrHandle;
+    freeTxBuffer(om);
+
+    ble_gap_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = BLE_GAP_EVENT_NOTIFY_TX;
+    event.notify_tx.status = 0;
+    event.notify_tx.conn_handle = connHandle;
+    event.notify_tx.attr_handle = attrHandle;
+    NimBLEFake::dispatch(event);
+}
+
+// Open a connection from a host
+uint16_t NimBLEFake::connect(const NimBLEAddress& address, uint16_t interval, uint16_t latency, uint16_t timeout) {
+    uint16_t connHandle = nextConnHandle++;
+    Connection& connection = connections[connHandle];
+    memset(&connection.desc, 0, sizeof(connection.desc));
+    connection.desc.conn_handle = connHandle;
+    connection.desc.conn_itvl = interval;
+    connection.desc.conn_latency = latency;
+    connection.desc.supervision_timeout = timeout;
+    connection.desc.role = BLE_GAP_ROLE_SLAVE;
+    connection.desc.our_id_addr.type = BLE_ADDR_PUBLIC;
+    memcpy(connection.desc.our_id_addr.val, OWN_ADDRESS, sizeof(OWN_ADDRESS));
+    connection.desc.our_ota_addr = connection.desc.our_id_addr;
+    connection.desc.peer_id_addr.type = address.getType();
+    memcpy(connection.desc.peer_id_addr.val, address.getNative(), sizeof(connection.desc.peer_id_addr.val));
+    connection.desc.peer_ota_addr = connection.desc.peer_id_addr;
+    connection.rssi = DEFAULT_RSSI;
+    connection.stalled = false;
+    connection.txPhy = BLE_GAP_LE_PHY_1M;
+    connection.rxPhy = BLE_GAP_LE_PHY_1M;
+
+    // The controller stops advertising on connection, without the completion callback
+    if (NimBLEDevice::pAdvertising != nullptr) {
+        NimBLEDevice::pAdvertising->advertising = false;
+    }
+
+    ble_gap_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = BLE_GAP_EVENT_CONNECT;
+    event.connect.status = 0;
+    event.connect.conn_handle = connHandle;
+    dispatch(event);
+    return connHandle;
+}
+
+// Close a connection, it is gone before the event is delivered
+void NimBLEFake::disconnect(uint16_t connHandle, int reason) {
+    Connection* connection = findConnection(connHandle);
+    if (connection == nullptr) {
+        return;
+    }
+
+    ble_gap_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = BLE_GAP_EVENT_DISCONNECT;
+    event.disconnect.reason = reason;
+    event.disconnect.conn = connection->desc;
+    for (os_mbuf* om : connection->pending) {
+        freeTxBuffer(om);
+    }
+    connections.erase(connHandle);
+    dispatch(event);
+}
+
+// Complete encryption, bonding the host when asked
+void NimBLEFake::encrypt(uint16_t connHandle, bool bonded) {
+    Connection* connection = findConnection(connHandle);
+    if (connection == nullptr) {
+        return;
+    }
+
+    connection->desc.sec_state.encrypted = 1;
+    connection->desc.sec_state.bonded = bonded;
+    connection->desc.sec_state.key_size = 16;
+    NimBLEAddress address(connection->desc.peer_id_addr);
+    bool restored = NimBLEDevice::isBonded(address);
+    if (!restored) {
+        storedCccds.erase(address.toString());
+    }
+    if (bonded && !restored) {
+        NimBLEDevice::bonds.push_back(address);
+    }
+
+    ble_gap_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = BLE_GAP_EVENT_ENC_CHANGE;
+    event.enc_change.status = 0;
+    event.enc_change.conn_handle = connHandle;
+    dispatch(event);
+
+    // Like ble_gatts_bonding_restored(), CCCDs kept for the bond come back after the encryption event
+    if (restored) {
+        std::vector<uint16_t> attrHandles = storedCccds[address.toString()];
+        for (uint16_t attrHandle : attrHandles) {
+            memset(&event, 0, sizeof(event));
+            event.type = BLE_GAP_EVENT_SUBSCRIBE;
+            event.subscribe.conn_handle = connHandle;
+            event.subscribe.attr_handle = attrHandle;
+            event.subscribe.reason = BLE_GAP_SUBSCRIBE_REASON_RESTORE;
+            event.subscribe.cur_notify = 1;
+            dispatch(event);
+        }
+    }
+}
+
+// Write a characteristic CCCD
+void NimBLEFake::subscribe(uint16_t connHandle, NimBLECharacteristic* pCharacteristic, bool notify) {
+    Connection* connection = findConnection(connHandle);
+    if (connection == nullptr || pCharacteristic == nullptr) {
+        return;
+    }
+
+    // Kept with the bond for the next encryption
+    std::vector<uint16_t>& stored = storedCccds[NimBLEAddress(connection->desc.peer_id_addr).toString()];
+    stored.erase(std::remove(stored.begin(), stored.end(), pCharacteristic->getHandle()), stored.end());
+    if (notify) {
+        stored.push_back(pCharacteristic->getHandle());
+    }
+
+    ble_gap_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = BLE_GAP_EVENT_SUBSCRIBE;
+    event.subscribe.conn_handle = connHandle;
+    event.subscribe.attr_handle = pCharacteristic->getHandle();
+    event.subscribe.reason = BLE_GAP_SUBSCRIBE_REASON_WRITE;
+    event.subscribe.cur_notify = notify;
+    dispatch(event);
+}
+
+// Write a characteristic value
+void NimBLEFake::write(uint16_t connHandle, NimBLECharacteristic* pCharacteristic, const uint8_t* data,
+                       size_t length) {
+    Connection* connection = findConnection(connHandle);
+    if (connection == nullptr || pCharacteristic == nullptr) {
+        return;
+    }
+
+    pCharacteristic->setValue(data, length);
+    if (pCharacteristic->getCallbacks() != nullptr) {
+        pCharacteristic->getCallbacks()->onWrite(pCharacteristic, &connection->desc);
+    }
+}
+
+// Read a characteristic value
+NimBLEAttValue NimBLEFake::read(uint16_t connHandle, NimBLECharacteristic* pCharacteristic) {
+    Connection* connection = findConnection(connHandle);
+    if (connection == nullptr || pCharacteristic == nullptr) {
+        return NimBLEAttValue();
+    }
+
+    if (pCharacteristic->getCallbacks() != nullptr) {
+        pCharacteristic->getCallbacks()->onRead(pCharacteristic, &connection->desc);
+    }
+    return pCharacteristic->getValue();
+}
+
+// Set the RSSI a connection reports
+void NimBLEFake::setRssi(uint16_t connHandle, int8_t rssi) {
+    Connection* connection = findConnection(connHandle);
+    if (connection != nullptr) {
+        connection->rssi = rssi;
+    }
+}
+
+// Deliver a GAP event: the custom handler first, then the server, like the NimBLE host
+void NimBLEFake::dispatch(ble_gap_event& event) {
+    if (NimBLEDevice::customGapHandler != nullptr) {
+        NimBLEDevice::customGapHandler(&event, nullptr);
+    }
+    if (NimBLEDevice::pServer != nullptr) {
+        NimBLEDevice::pServer->handleGapEvent(&event);
+    }
+}
+
+// Let hosts accept or refuse 2M PHY
+void NimBLEFake::setPhy2M(bool supported) {
+    phy2M = supported;
+}
+
+// Run the work the host task would have done since the last call
+void NimBLEFake::runHostTasks() {
+    while (!portEvents.empty()) {
+        ble_npl_event* event = portEvents.front();
+        portEvents.pop_front();
+        event->queued = false;
+        event->fn(event);
+    }
+
+    while (!deferredEvents.empty()) {
+        std::function<void()> event = deferredEvents.front();
+        deferredEvents.pop_front();
+        event();
+    }
+
+    NimBLEAdvertising* pAdvertising = NimBLEDevice::pAdvertising;
+    if (pAdvertising != nullptr && pAdvertising->advertising && pAdvertising->duration != 0 &&
+        millis() - pAdvertising->startTime >= pAdvertising->duration * 1000) {
+        completeAdvertising();
+    }
+
+    if (!congested) {
+        for (auto& entry : connections) {
+            if (!entry.second.stalled) {
+                completeTx(entry.first);
+            }
+        }
+    }
+}
+
+// End advertising as if its duration ran out
+void NimBLEFake::completeAdvertising() {
+    NimBLEAdvertising* pAdvertising = NimBLEDevice::pAdvertising;
+    if (pAdvertising == nullptr || !pAdvertising->advertising) {
+        return;
+    }
+
+    pAdvertising->advertising = false;
+    if (pAdvertising->completeCallback != nullptr) {
+        pAdvertising->completeCallback(pAdvertising);
+    }
+}
+
+// Resize the buffer pool
+void NimBLEFake::setTxBuffers(uint16_t count) {
+    for (auto& entry : connections) {
+        entry.second.pending.clear();
+    }
+    txBuffers.assign(count, os_mbuf());
+    freeTxBuffers = count;
+}
+
+// Hold notifications in the controller instead of sending them
+void NimBLEFake::setCongested(bool congested) {
+    ::congested = congested;
+}
+
+// Hold one host's notifications in the controller, as if it stopped acknowledging
+void NimBLEFake::setStalled(uint16_t connHandle, bool stalled) {
+    Connection* connection = findConnection(connHandle);
+    if (connection != nullptr) {
+        connection->stalled = stalled;
+    }
+}
+
+// Send held notifications of a connection, as a connection event would
+uint16_t NimBLEFake::completeTx(uint16_t connHandle, uint16_t count) {
+    uint16_t sent = 0;
+    while (sent < count) {
+        Connection* connection = findConnection(connHandle);
+        if (connection == nullptr || connection->pending.empty()) {
+            break;
+        }
+        os_mbuf* om = connection->pending.front();
+        connection->pending.pop_front();
+        transmit(connHandle, om);
+        sent++;
+    }
+    return sent;
+}
+
+// Get the number of notifications held for a connection
+uint16_t NimBLEFake::getPendingTx(uint16_t connHandle) {
+    Connection* connection = findConnection(connHandle);
+    return connection != nullptr ? connection->pending.size() : 0;
+}
+
+// Find a characteristic in the server by UUID
+NimBLECharacteristic* NimBLEFake::getCharacteristic(const NimBLEUUID& uuid, uint16_t instanceId) {
+    if (NimBLEDevice::pServer == nullptr) {
+        return nullptr;
+    }
+    for (NimBLEService* pService : NimBLEDevice::pServer->services) {
+        for (uint16_t i = 0;; i++) {
+            NimBLECharacteristic* pCharacteristic = pService->getCharacteristic(uuid, i);
+            if (pCharacteristic == nullptr) {
+                break;
+            }
+            if (instanceId-- == 0) {
+                return pCharacteristic;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Get the notifications sent so far
+const std::vector<NimBLEFake::Notification>& NimBLEFake::getNotifications() {
+    return notifications;
+}
+
+void NimBLEFake::clearNotifications() {
+    notifications.clear();
+}
+
+// Get the number of Service Changed indications requested
+uint16_t NimBLEFake::getServiceChangedCount() {
+    return serviceChangedCount;
+}
+
+// Get the number of connection parameter update requests
+uint16_t NimBLEFake::getConnParamsRequests() {
+    return connParamsRequests;
+}
+
+// Get the number of PHY update requests
+uint16_t NimBLEFake::getPhyRequests() {
+    return phyRequests;
+}
+
+// Tear down the stack and every simulated host
+void NimBLEFake::reset() {
+    NimBLEDevice::deinit(true);
+    NimBLEDevice::deleteAllBonds();
+    connections.clear();
+    storedCccds.clear();
+    nextConnHandle = 1;
+    setTxBuffers(DEFAULT_TX_BUFFERS);
+    congested = false;
+    phy2M = true;
+    notifications.clear();
+    portEvents.clear();
+    deferredEvents.clear();
+    serviceChangedCount = 0;
+    connParamsRequests = 0;
+    phyRequests = 0;
+}
+
+// ---- NimBLE host C API ----
+
+// Get the descriptor of a connection
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc* out_desc) {
+    Connection* connection = findConnection(handle);
+    if (connection == nullptr) {
+        return BLE_HS_ENOTCONN;
+    }
+    if (out_desc != nullptr) {
+        *out_desc = connection->desc;
+    }
+    return 0;
+}
+
+// Get the RSSI of a connection
+int ble_gap_conn_rssi(uint16_t conn_handle, int8_t* out_rssi) {
+    Connection* connection = findConnection(conn_handle);
+    if (connection == nullptr) {
+        return BLE_HS_ENOTCONN;
+    }
+    *out_rssi = connection->rssi;
+    return 0;
+}
+
+// Terminate a connection, the disconnect event follows on the host task
+int ble_gap_terminate(uint16_t conn_handle, uint8_t) {
+    if (findConnection(conn_handle) == nullptr) {
+        return BLE_HS_ENOTCONN;
+    }
+    deferredEvents.push_back([conn_handle]() {
+        NimBLEFake::disconnect(conn_handle, NimBLEFake::REASON_LOCAL_TERMINATED);
+    });
+    return 0;
+}
+
+// Request connection parameters, the host accepts the shortest interval asked for
+int ble_gap_update_params(uint16_t conn_handle, const struct ble_gap_upd_params* params) {
+    if (findConnection(conn_handle) == nullptr) {
+        return BLE_HS_ENOTCONN;
+    }
+    connParamsRequests++;
+    ble_gap_upd_params accepted = *params;
+    deferredEvents.push_back([conn_handle, accepted]() {
+        Connection* connection = findConnection(conn_handle);
+        if (connection == nullptr) {
+            return;
+        }
+        connection->desc.conn_itvl = accepted.itvl_min;
+        connection->desc.conn_latency = accepted.latency;
+        connection->desc.supervision_timeout = accepted.supervision_timeout;
+
+        ble_gap_event event;
+        memset(&event, 0, sizeof(event));
+        event.type = BLE_GAP_EVENT_CONN_UPDATE;
+        event.conn_update.status = 0;
+        event.conn_update.conn_handle = conn_handle;
+        NimBLEFake::dispatch(event);
+    });
+    return 0;
+}
+
+// Get the PHYs of a connection
+int ble_gap_read_le_phy(uint16_t conn_handle, uint8_t* tx_phy, uint8_t* rx_phy) {
+    Connection* connection = findConnection(conn_handle);
+    if (connection == nullptr) {
+        return BLE_HS_ENOTCONN;
+    }
+    *tx_phy = connection->txPhy;
+    *rx_phy = connection->rxPhy;
+    return 0;
+}
+
+// Request PHYs, the update completes on the host task
+int ble_gap_set_prefered_le_phy(uint16_t conn_handle, uint8_t tx_phys_mask, uint8_t rx_phys_mask, uint16_t) {
+    if (findConnection(conn_handle) == nullptr) {
+        return BLE_HS_ENOTCONN;
+    }
+    phyRequests++;
+    uint8_t phy = phy2M && (tx_phys_mask & rx_phys_mask & BLE_GAP_LE_PHY_2M_MASK) ? BLE_GAP_LE_PHY_2M
+                                                                                  : BLE_GAP_LE_PHY_1M;
+    deferredEvents.push_back([conn_handle, phy]() {
+        Connection* connection = findConnection(conn_handle);
+        if (connection == nullptr) {
+            return;
+        }
+        connection->txPhy = phy;
+        connection->rxPhy = phy;
+
+        ble_gap_event event;
+        memset(&event, 0, sizeof(event));
+        event.type = BLE_GAP_EVENT_PHY_UPDATE_COMPLETE;
+        event.phy_updated.status = 0;
+        event.phy_updated.conn_handle = conn_handle;
+        event.phy_updated.tx_phy = phy;
+        event.phy_updated.rx_phy = phy;
+        NimBLEFake::dispatch(event);
+    });
+    return 0;
+}
+
+// Default PHY preference, hosts follow setPhy2M() instead
+int ble_gap_set_prefered_default_le_phy(uint8_t, uint8_t) {
+    return 0;
+}
+
+// Data length has no effect on the simulated link
+int ble_hs_hci_util_set_data_len(uint16_t conn_handle, uint16_t, uint16_t) {
+    return findConnection(conn_handle) != nullptr ? 0 : BLE_HS_ENOTCONN;
+}
+
+// Take a buffer from the pool, nullptr once it is exhausted
+struct os_mbuf* ble_hs_mbuf_from_flat(const void* buf, uint16_t len) {
+    if (freeTxBuffers == 0 || len > NimBLEFake::TX_BUFFER_SIZE) {
+        return nullptr;
+    }
+    for (os_mbuf& om : txBuffers) {
+        if (!om.used) {
+            om.used = true;
+            om.length = len;
+            memcpy(om.data, buf, len);
+            freeTxBuffers--;
+            return &om;
+        }
+    }
+    return nullptr;
+}
+
+// Send a notification, consuming the buffer. A congested controller holds it until completeTx()
+int ble_gattc_notify_custom(uint16_t conn_handle, uint16_t att_handle, struct os_mbuf* om) {
+    if (om == nullptr) {
+        return BLE_HS_EINVAL;
+    }
+    Connection* connection = findConnection(conn_handle);
+    if (connection == nullptr) {
+        freeTxBuffer(om);
+        return BLE_HS_ENOTCONN;
+    }
+
+    om->attrHandle = att_handle;
+    if (congested || connection->stalled || !connection->pending.empty()) {
+        connection->pending.push_back(om);
+    } else {
+        transmit(conn_handle, om);
+    }
+    return 0;
+}
+
+// Get the number of free buffers
+int os_msys_num_free(void) {
+    return freeTxBuffers;
+}
+
+// Secure Connections key pair, nothing to compute on the host
+int ble_sm_sc_oob_generate_data(struct ble_sm_sc_oob_data* oob_data) {
+    memset(oob_data, 0, sizeof(*oob_data));
+    return 0;
+}
+
+// Count Service Changed requests
+void ble_svc_gatt_changed(uint16_t, uint16_t) {
+    serviceChangedCount++;
+}
+
+// Default event queue, drained by NimBLEFake::runHostTasks()
+struct ble_npl_eventq* nimble_port_get_dflt_eventq(void) {
+    return &defaultEventq;
+}
+
+void ble_npl_event_init(struct ble_npl_event* event, ble_npl_event_fn* fn, void* arg) {
+    event->fn = fn;
+    event->arg = arg;
+    event->queued = false;
+}
+
+// Queue an event once, like the NimBLE port
+void ble_npl_eventq_put(struct ble_npl_eventq*, struct ble_npl_event* event) {
+    if (!event->queued) {
+        event->queued = true;
+        portEvents.push_back(event);
+    }
+}
+
+// Mutex, recursive and never contended on one thread
+ble_npl_error_t ble_npl_mutex_init(struct ble_npl_mutex* mutex) {
+    mutex->depth = 0;
+    return BLE_NPL_OK;
+}
+
+ble_npl_error_t ble_npl_mutex_pend(struct ble_npl_mutex* mutex, ble_npl_time_t) {
+    mutex->depth++;
+    return BLE_NPL_OK;
+}
+
+ble_npl_error_t ble_npl_mutex_release(struct ble_npl_mutex* mutex) {
+    if (mutex->depth == 0) {
+        return BLE_NPL_EINVAL;
+    }
+    mutex->depth--;
+    return BLE_NPL_OK;
+}
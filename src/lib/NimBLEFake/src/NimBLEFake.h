@@ -0,0 +1,78 @@
+// NimBLEFake.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// Control side of the NimBLE stand-in: plays the connected hosts and the
+// controller. Host events go through the custom GAP handler first and then
+// the server callbacks, in the order the NimBLE host delivers them. Events
+// the stack would raise later, such as a connection parameter update after a
+// request, are queued and delivered by runHostTasks().
+
+#ifndef NIMBLE_FAKE_H
+#define NIMBLE_FAKE_H
+
+#include <stdint.h>
+#include <vector>
+#include "NimBLEDevice.h"
+
+class NimBLEFake {
+public:
+    // Host buffer pool, CONFIG_BT_NIMBLE_MSYS1_BLOCK_COUNT on the ESP32
+    static const uint16_t DEFAULT_TX_BUFFERS = 12;
+    static const uint16_t TX_BUFFER_SIZE = 256;
+
+    // Default link of a new connection (1.25 ms / 10 ms units)
+    static const uint16_t DEFAULT_CONN_INTERVAL = 24;
+    static const uint16_t DEFAULT_CONN_LATENCY = 0;
+    static const uint16_t DEFAULT_CONN_TIMEOUT = 400;
+    static const int8_t DEFAULT_RSSI = -50;
+
+    // Disconnect reasons as GAP events report them
+    static const int REASON_SUPERVISION_TIMEOUT = BLE_HS_ERR_HCI_BASE + BLE_ERR_CONN_SPVN_TMO;
+    static const int REASON_REMOTE_TERMINATED = BLE_HS_ERR_HCI_BASE + BLE_ERR_REM_USER_CONN_TERM;
+    static const int REASON_LOCAL_TERMINATED = BLE_HS_ERR_HCI_BASE + BLE_ERR_CONN_TERM_LOCAL;
+
+    // A notification that went on air
+    struct Notification {
+        uint32_t time;          // micros()
+        uint16_t connHandle;
+        uint16_t attrHandle;
+        std::vector<uint8_t> value;
+    };
+
+    // Host events
+    static uint16_t connect(const NimBLEAddress& address, uint16_t interval = DEFAULT_CONN_INTERVAL,
+                            uint16_t latency = DEFAULT_CONN_LATENCY, uint16_t timeout = DEFAULT_CONN_TIMEOUT);
+    static void disconnect(uint16_t connHandle, int reason = REASON_REMOTE_TERMINATED);
+    static void encrypt(uint16_t connHandle, bool bonded = true);  // restores the CCCDs of a known bond
+    static void subscribe(uint16_t connHandle, NimBLECharacteristic* pCharacteristic, bool notify = true);
+    static void write(uint16_t connHandle, NimBLECharacteristic* pCharacteristic, const uint8_t* data, size_t length);
+    static NimBLEAttValue read(uint16_t connHandle, NimBLECharacteristic* pCharacteristic);
+    static void setRssi(uint16_t connHandle, int8_t rssi);
+    static void setPhy2M(bool supported);           // hosts accept 2M PHY requests, true by default
+    static void dispatch(ble_gap_event& event);     // any other GAP event, custom handler then server
+
+    // Stack work: queued port events, deferred GAP events, advertising timeouts, uncongested TX
+    static void runHostTasks();
+    static void completeAdvertising();              // end the advertising duration now
+
+    // TX congestion
+    static void setTxBuffers(uint16_t count);       // drops buffers in flight
+    static void setCongested(bool congested);       // hold notifications instead of sending them
+    static void setStalled(uint16_t connHandle, bool stalled);  // the same for one host
+    static uint16_t completeTx(uint16_t connHandle, uint16_t count = 0xFFFF);   // send held notifications
+    static uint16_t getPendingTx(uint16_t connHandle);
+
+    // Inspection
+    static NimBLECharacteristic* getCharacteristic(const NimBLEUUID& uuid, uint16_t instanceId = 0);
+    static const std::vector<Notification>& getNotifications();
+    static void clearNotifications();
+    static uint16_t getServiceChangedCount();
+    static uint16_t getConnParamsRequests();
+    static uint16_t getPhyRequests();
+
+    // Tear down the stack and every simulated host
+    static void reset();
+};
+
+#endif // NIMBLE_FAKE_H
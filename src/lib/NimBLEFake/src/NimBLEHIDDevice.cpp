@@ -0,0 +1,98 @@
+// NimBLEHIDDevice.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "NimBLEHIDDevice.h"
+
+// Constructor, creates the services and the fixed characteristics in NimBLE's order
+NimBLEHIDDevice::NimBLEHIDDevice(NimBLEServer* pServer) {
+    pDeviceInfoService = pServer->createService(NimBLEUUID((uint16_t)0x180A));
+    pHidService = pServer->createService(NimBLEUUID((uint16_t)0x1812));
+    pBatteryService = pServer->createService(NimBLEUUID((uint16_t)0x180F));
+
+    pPnpCharacteristic = pDeviceInfoService->createCharacteristic(NimBLEUUID((uint16_t)0x2A50),
+                                                                  NIMBLE_PROPERTY::READ);
+    pHidInfoCharacteristic = pHidService->createCharacteristic(NimBLEUUID((uint16_t)0x2A4A), NIMBLE_PROPERTY::READ);
+    pReportMapCharacteristic = pHidService->createCharacteristic(NimBLEUUID((uint16_t)0x2A4B),
+                                                                 NIMBLE_PROPERTY::READ);
+    pHidControlCharacteristic = pHidService->createCharacteristic(NimBLEUUID((uint16_t)0x2A4C),
+                                                                  NIMBLE_PROPERTY::WRITE_NR);
+    pProtocolModeCharacteristic = pHidService->createCharacteristic(NimBLEUUID((uint16_t)0x2A4E),
+                                                                    NIMBLE_PROPERTY::WRITE_NR | NIMBLE_PROPERTY::READ);
+    pBatteryLevelCharacteristic = pBatteryService->createCharacteristic(NimBLEUUID((uint16_t)0x2A19),
+                                                                        NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY);
+    pManufacturerCharacteristic = nullptr;
+
+    // Report protocol
+    uint8_t protocolMode = 0x01;
+    pProtocolModeCharacteristic->setValue(&protocolMode, 1);
+}
+
+// Set the report map
+void NimBLEHIDDevice::reportMap(uint8_t* map, uint16_t length) {
+    pReportMapCharacteristic->setValue(map, length);
+}
+
+// Start the services
+void NimBLEHIDDevice::startServices() {
+    pDeviceInfoService->start();
+    pHidService->start();
+    pBatteryService->start();
+}
+
+NimBLEService* NimBLEHIDDevice::deviceInfo() {
+    return pDeviceInfoService;
+}
+
+NimBLEService* NimBLEHIDDevice::hidService() {
+    return pHidService;
+}
+
+NimBLEService* NimBLEHIDDevice::batteryService() {
+    return pBatteryService;
+}
+
+// Manufacturer Name, created on first use
+NimBLECharacteristic* NimBLEHIDDevice::manufacturer() {
+    if (pManufacturerCharacteristic == nullptr) {
+        pManufacturerCharacteristic = pDeviceInfoService->createCharacteristic(NimBLEUUID((uint16_t)0x2A29),
+                                                                               NIMBLE_PROPERTY::READ);
+    }
+    return pManufacturerCharacteristic;
+}
+
+// Set the PnP ID
+void NimBLEHIDDevice::pnp(uint8_t sig, uint16_t vid, uint16_t pid, uint16_t version) {
+    uint8_t value[] = { sig, (uint8_t)(vid & 0xFF), (uint8_t)(vid >> 8), (uint8_t)(pid & 0xFF),
+                        (uint8_t)(pid >> 8), (uint8_t)(version & 0xFF), (uint8_t)(version >> 8) };
+    pPnpCharacteristic->setValue(value, sizeof(value));
+}
+
+// Set the HID Information
+void NimBLEHIDDevice::hidInfo(uint8_t country, uint8_t flags) {
+    uint8_t value[] = { 0x11, 0x01, country, flags };
+    pHidInfoCharacteristic->setValue(value, sizeof(value));
+}
+
+NimBLECharacteristic* NimBLEHIDDevice::hidControl() {
+    return pHidControlCharacteristic;
+}
+
+NimBLECharacteristic* NimBLEHIDDevice::protocolMode() {
+    return pProtocolModeCharacteristic;
+}
+
+// Create an input report characteristic, the report ID lives in its Report Reference descriptor
+NimBLECharacteristic* NimBLEHIDDevice::inputReport(uint8_t) {
+    return pHidService->createCharacteristic(NimBLEUUID((uint16_t)0x2A4D), NIMBLE_PROPERTY::READ |
+                                             NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::READ_ENC);
+}
+
+NimBLECharacteristic* NimBLEHIDDevice::batteryLevel() {
+    return pBatteryLevelCharacteristic;
+}
+
+// Set the battery level without notifying
+void NimBLEHIDDevice::setBatteryLevel(uint8_t level) {
+    pBatteryLevelCharacteristic->setValue(&level, 1);
+}
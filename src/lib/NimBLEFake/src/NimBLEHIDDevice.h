@@ -0,0 +1,12 @@
+// NimBLEHIDDevice.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// The fake declares the whole NimBLE API in NimBLEDevice.h.
+
+#ifndef NIMBLE_HID_DEVICE_FAKE_H
+#define NIMBLE_HID_DEVICE_FAKE_H
+
+#include "NimBLEDevice.h"
+
+#endif // NIMBLE_HID_DEVICE_FAKE_H
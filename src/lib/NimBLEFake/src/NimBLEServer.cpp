@@ -0,0 +1,425 @@
+// NimBLEServer.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "NimBLEServer.h"
+#include <string.h>
+#include <algorithm>
+
+// CCCD bits
+static const uint16_t SUB_NOTIFY = 0x0001;
+static const uint16_t SUB_INDICATE = 0x0002;
+
+// Constructor
+NimBLEServer::NimBLEServer() {
+    pCallbacks = nullptr;
+    deleteCallbacks = false;
+    advertiseOnDisconnectEnabled = true;
+    started = false;
+    nextHandle = 1;
+}
+
+// Destructor, deletes the GATT database
+NimBLEServer::~NimBLEServer() {
+    for (NimBLEService* pService : services) {
+        delete pService;
+    }
+    if (deleteCallbacks) {
+        delete pCallbacks;
+    }
+}
+
+// Create a service, handles are assigned in creation order
+NimBLEService* NimBLEServer::createService(const char* uuid) {
+    return createService(NimBLEUUID(uuid));
+}
+
+NimBLEService* NimBLEServer::createService(const NimBLEUUID& uuid) {
+    NimBLEService* pService = new NimBLEService(uuid, this, allocateHandles(1));
+    services.push_back(pService);
+    return pService;
+}
+
+// Find a service by UUID
+NimBLEService* NimBLEServer::getServiceByUUID(const NimBLEUUID& uuid, uint16_t instanceId) {
+    for (NimBLEService* pService : services) {
+        if (pService->getUUID() == uuid && instanceId-- == 0) {
+            return pService;
+        }
+    }
+    return nullptr;
+}
+
+// Register the GATT database
+void NimBLEServer::start() {
+    started = true;
+}
+
+// Check if the GATT database is registered
+bool NimBLEServer::isStarted() {
+    return started;
+}
+
+// Set the connection callbacks
+void NimBLEServer::setCallbacks(NimBLEServerCallbacks* pCallbacks, bool deleteCallbacks) {
+    if (this->deleteCallbacks && this->pCallbacks != pCallbacks) {
+        delete this->pCallbacks;
+    }
+    this->pCallbacks = pCallbacks;
+    this->deleteCallbacks = deleteCallbacks;
+}
+
+// Restart advertising when a host disconnects
+void NimBLEServer::advertiseOnDisconnect(bool enabled) {
+    advertiseOnDisconnectEnabled = enabled;
+}
+
+// Get the number of connected hosts
+size_t NimBLEServer::getConnectedCount() {
+    return peers.size();
+}
+
+// Get the connection handles, in connection order
+std::vector<uint16_t> NimBLEServer::getPeerDevices() {
+    return peers;
+}
+
+// Get connection information by index
+NimBLEConnInfo NimBLEServer::getPeerInfo(size_t index) {
+    return getPeerIDInfo(index < peers.size() ? peers[index] : BLE_HS_CONN_HANDLE_NONE);
+}
+
+// Get connection information by handle, zeroed if not connected
+NimBLEConnInfo NimBLEServer::getPeerIDInfo(uint16_t connHandle) {
+    ble_gap_conn_desc desc;
+    if (ble_gap_conn_find(connHandle, &desc) != 0) {
+        memset(&desc, 0, sizeof(desc));
+        desc.conn_handle = BLE_HS_CONN_HANDLE_NONE;
+    }
+    return NimBLEConnInfo(desc);
+}
+
+// Terminate a connection, the disconnect event follows
+int NimBLEServer::disconnect(uint16_t connHandle, uint8_t reason) {
+    return ble_gap_terminate(connHandle, reason);
+}
+
+// Request connection parameters from a host
+void NimBLEServer::updateConnParams(uint16_t connHandle, uint16_t minInterval, uint16_t maxInterval,
+                                    uint16_t latency, uint16_t timeout) {
+    ble_gap_upd_params params;
+    params.itvl_min = minInterval;
+    params.itvl_max = maxInterval;
+    params.latency = latency;
+    params.supervision_timeout = timeout;
+    params.min_ce_len = 0;
+    params.max_ce_len = 0;
+    ble_gap_update_params(connHandle, &params);
+}
+
+// Request a data length, the transmit time follows from the octets
+void NimBLEServer::setDataLen(uint16_t connHandle, uint16_t txOctets) {
+    ble_hs_hci_util_set_data_len(connHandle, txOctets, (txOctets + 14) * 8);
+}
+
+// Get the advertising object
+NimBLEAdvertising* NimBLEServer::getAdvertising() {
+    return NimBLEDevice::getAdvertising();
+}
+
+// Start advertising
+bool NimBLEServer::startAdvertising() {
+    return getAdvertising()->start();
+}
+
+// Stop advertising
+bool NimBLEServer::stopAdvertising() {
+    return getAdvertising()->stop();
+}
+
+// Reserve attribute handles
+uint16_t NimBLEServer::allocateHandles(uint16_t count) {
+    uint16_t handle = nextHandle;
+    nextHandle += count;
+    return handle;
+}
+
+// Find a characteristic by value handle
+NimBLECharacteristic* NimBLEServer::findCharacteristic(uint16_t handle) {
+    for (NimBLEService* pService : services) {
+        NimBLECharacteristic* pCharacteristic = pService->getCharacteristicByHandle(handle);
+        if (pCharacteristic != nullptr) {
+            return pCharacteristic;
+        }
+    }
+    return nullptr;
+}
+
+// Server side of the GAP events, after the custom handler
+void NimBLEServer::handleGapEvent(ble_gap_event* event) {
+    ble_gap_conn_desc desc;
+
+    switch (event->type) {
+        case BLE_GAP_EVENT_CONNECT:
+            if (event->connect.status != 0 || ble_gap_conn_find(event->connect.conn_handle, &desc) != 0) {
+                break;
+            }
+            peers.push_back(event->connect.conn_handle);
+            if (pCallbacks != nullptr) {
+                pCallbacks->onConnect(this);
+                pCallbacks->onConnect(this, &desc);
+            }
+            break;
+
+        case BLE_GAP_EVENT_DISCONNECT:
+            peers.erase(std::remove(peers.begin(), peers.end(), event->disconnect.conn.conn_handle), peers.end());
+            for (NimBLEService* pService : services) {
+                for (NimBLECharacteristic* pCharacteristic : pService->characteristics) {
+                    pCharacteristic->removeSubscription(event->disconnect.conn.conn_handle);
+                }
+            }
+            if (pCallbacks != nullptr) {
+                pCallbacks->onDisconnect(this);
+                pCallbacks->onDisconnect(this, &event->disconnect.conn);
+            }
+            if (advertiseOnDisconnectEnabled) {
+                startAdvertising();
+            }
+            break;
+
+        case BLE_GAP_EVENT_SUBSCRIBE: {
+            NimBLECharacteristic* pCharacteristic = findCharacteristic(event->subscribe.attr_handle);
+            if (pCharacteristic == nullptr || ble_gap_conn_find(event->subscribe.conn_handle, &desc) != 0) {
+                break;
+            }
+            uint16_t subValue = (event->subscribe.cur_notify ? SUB_NOTIFY : 0) |
+                                (event->subscribe.cur_indicate ? SUB_INDICATE : 0);
+            pCharacteristic->setSubscribe(event->subscribe.conn_handle, subValue);
+            if (pCharacteristic->getCallbacks() != nullptr) {
+                pCharacteristic->getCallbacks()->onSubscribe(pCharacteristic, &desc, subValue);
+            }
+            break;
+        }
+
+        case BLE_GAP_EVENT_ENC_CHANGE:
+            if (event->enc_change.status != 0 || ble_gap_conn_find(event->enc_change.conn_handle, &desc) != 0) {
+                break;
+            }
+            if (pCallbacks != nullptr) {
+                pCallbacks->onAuthenticationComplete(&desc);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Service constructor
+NimBLEService::NimBLEService(const NimBLEUUID& uuid, NimBLEServer* pServer, uint16_t handle)
+    : uuid(uuid), pServer(pServer), handle(handle), started(false) {}
+
+// Destructor, deletes the characteristics
+NimBLEService::~NimBLEService() {
+    for (NimBLECharacteristic* pCharacteristic : characteristics) {
+        delete pCharacteristic;
+    }
+}
+
+// Create a characteristic: declaration, value and a CCCD when it notifies or indicates
+NimBLECharacteristic* NimBLEService::createCharacteristic(const char* uuid, uint32_t properties,
+                                                         uint16_t maxLength) {
+    return createCharacteristic(NimBLEUUID(uuid), properties, maxLength);
+}
+
+NimBLECharacteristic* NimBLEService::createCharacteristic(const NimBLEUUID& uuid, uint32_t properties,
+                                                         uint16_t) {
+    bool cccd = properties & (NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::INDICATE);
+    uint16_t declaration = pServer->allocateHandles(cccd ? 3 : 2);
+    NimBLECharacteristic* pCharacteristic = new NimBLECharacteristic(uuid, properties, this, declaration + 1);
+    characteristics.push_back(pCharacteristic);
+    return pCharacteristic;
+}
+
+// Find a characteristic by UUID
+NimBLECharacteristic* NimBLEService::getCharacteristic(const NimBLEUUID& uuid, uint16_t instanceId) {
+    for (NimBLECharacteristic* pCharacteristic : characteristics) {
+        if (pCharacteristic->getUUID() == uuid && instanceId-- == 0) {
+            return pCharacteristic;
+        }
+    }
+    return nullptr;
+}
+
+// Find a characteristic by value handle
+NimBLECharacteristic* NimBLEService::getCharacteristicByHandle(uint16_t handle) {
+    for (NimBLECharacteristic* pCharacteristic : characteristics) {
+        if (pCharacteristic->getHandle() == handle) {
+            return pCharacteristic;
+        }
+    }
+    return nullptr;
+}
+
+// Mark the service ready for registration
+bool NimBLEService::start() {
+    started = true;
+    return true;
+}
+
+bool NimBLEService::isStarted() {
+    return started;
+}
+
+NimBLEUUID NimBLEService::getUUID() {
+    return uuid;
+}
+
+uint16_t NimBLEService::getHandle() {
+    return handle;
+}
+
+// Characteristic constructor
+NimBLECharacteristic::NimBLECharacteristic(const NimBLEUUID& uuid, uint32_t properties, NimBLEService* pService,
+                                           uint16_t handle)
+    : uuid(uuid), properties(properties), pService(pService), handle(handle), pCallbacks(nullptr) {}
+
+// Destructor, the callbacks stay with the application like in NimBLE
+NimBLECharacteristic::~NimBLECharacteristic() {}
+
+// Set the value
+void NimBLECharacteristic::setValue(const uint8_t* data, size_t length) {
+    value.assign(data, data + length);
+}
+
+void NimBLECharacteristic::setValue(const std::string& value) {
+    setValue((const uint8_t*)value.data(), value.size());
+}
+
+void NimBLECharacteristic::setValue(const char* value) {
+    setValue((const uint8_t*)value, strlen(value));
+}
+
+// Get the value, the fake keeps no timestamp
+NimBLEAttValue NimBLECharacteristic::getValue(time_t* timestamp) {
+    if (timestamp != nullptr) {
+        *timestamp = 0;
+    }
+    return NimBLEAttValue(value.data(), value.size());
+}
+
+// Notify the current value to every subscribed connection
+void NimBLECharacteristic::notify(bool isNotification) {
+    notify(value.data(), value.size(), isNotification);
+}
+
+// Notify a value to every subscribed connection, through the host buffer pool like the real stack
+void NimBLECharacteristic::notify(const uint8_t* value, size_t length, bool isNotification) {
+    if (subscriptions.empty()) {
+        if (pCallbacks != nullptr) {
+            pCallbacks->onStatus(this, NimBLECharacteristicCallbacks::ERROR_NO_CLIENT, 0);
+        }
+        return;
+    }
+
+    for (const auto& subscription : subscriptions) {
+        uint16_t wanted = isNotification ? SUB_NOTIFY : SUB_INDICATE;
+        if (!(subscription.second & wanted)) {
+            continue;
+        }
+
+        os_mbuf* om = ble_hs_mbuf_from_flat(value, length);
+        int rc = om != nullptr ? ble_gattc_notify_custom(subscription.first, handle, om) : BLE_HS_ENOMEM;
+        if (pCallbacks != nullptr) {
+            pCallbacks->onNotify(this);
+            pCallbacks->onStatus(this, rc == 0 ? NimBLECharacteristicCallbacks::SUCCESS_NOTIFY
+                                               : NimBLECharacteristicCallbacks::ERROR_GATT, rc);
+        }
+    }
+}
+
+// Indications are sent like notifications, without waiting for the confirmation
+void NimBLECharacteristic::indicate() {
+    notify(false);
+}
+
+// Get the number of subscribed connections
+size_t NimBLECharacteristic::getSubscribedCount() {
+    return subscriptions.size();
+}
+
+// Set the callbacks
+void NimBLECharacteristic::setCallbacks(NimBLECharacteristicCallbacks* pCallbacks) {
+    this->pCallbacks = pCallbacks;
+}
+
+NimBLECharacteristicCallbacks* NimBLECharacteristic::getCallbacks() {
+    return pCallbacks;
+}
+
+uint16_t NimBLECharacteristic::getHandle() {
+    return handle;
+}
+
+uint32_t NimBLECharacteristic::getProperties() {
+    return properties;
+}
+
+NimBLEUUID NimBLECharacteristic::getUUID() {
+    return uuid;
+}
+
+NimBLEService* NimBLECharacteristic::getService() {
+    return pService;
+}
+
+// Record a CCCD write, 0 removes the subscription
+void NimBLECharacteristic::setSubscribe(uint16_t connHandle, uint16_t subValue) {
+    removeSubscription(connHandle);
+    if (subValue != 0) {
+        subscriptions.push_back(std::make_pair(connHandle, subValue));
+    }
+}
+
+// Forget the subscription of a connection
+void NimBLECharacteristic::removeSubscription(uint16_t connHandle) {
+    for (auto it = subscriptions.begin(); it != subscriptions.end(); ++it) {
+        if (it->first == connHandle) {
+            subscriptions.erase(it);
+            return;
+        }
+    }
+}
+
+// Default callbacks do nothing, the descriptor variants call the plain ones
+NimBLECharacteristicCallbacks::~NimBLECharacteristicCallbacks() {}
+
+void NimBLECharacteristicCallbacks::onRead(NimBLECharacteristic*) {}
+
+void NimBLECharacteristicCallbacks::onRead(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc*) {
+    onRead(pCharacteristic);
+}
+
+void NimBLECharacteristicCallbacks::onWrite(NimBLECharacteristic*) {}
+
+void NimBLECharacteristicCallbacks::onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc*) {
+    onWrite(pCharacteristic);
+}
+
+void NimBLECharacteristicCallbacks::onNotify(NimBLECharacteristic*) {}
+
+void NimBLECharacteristicCallbacks::onStatus(NimBLECharacteristic*, Status, int) {}
+
+void NimBLECharacteristicCallbacks::onSubscribe(NimBLECharacteristic*, ble_gap_conn_desc*, uint16_t) {}
+
+NimBLEServerCallbacks::~NimBLEServerCallbacks() {}
+
+void NimBLEServerCallbacks::onConnect(NimBLEServer*) {}
+
+void NimBLEServerCallbacks::onConnect(NimBLEServer*, ble_gap_conn_desc*) {}
+
+void NimBLEServerCallbacks::onDisconnect(NimBLEServer*) {}
+
+void NimBLEServerCallbacks::onDisconnect(NimBLEServer*, ble_gap_conn_desc*) {}
+
+void NimBLEServerCallbacks::onAuthenticationComplete(ble_gap_conn_desc*) {}
@@ -0,0 +1,12 @@
+// NimBLEUtils.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// The fake declares the whole NimBLE API in NimBLEDevice.h.
+
+#ifndef NIMBLE_UTILS_FAKE_H
+#define NIMBLE_UTILS_FAKE_H
+
+#include "NimBLEDevice.h"
+
+#endif // NIMBLE_UTILS_FAKE_H
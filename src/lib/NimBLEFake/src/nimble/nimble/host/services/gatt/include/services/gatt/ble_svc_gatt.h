@@ -0,0 +1,17 @@
+// ble_svc_gatt.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// Host stand-in for the GATT service API. Service Changed requests are
+// counted by NimBLEFake.
+
+#ifndef BLE_SVC_GATT_FAKE_H
+#define BLE_SVC_GATT_FAKE_H
+
+#include <stdint.h>
+
+extern "C" {
+void ble_svc_gatt_changed(uint16_t start_handle, uint16_t end_handle);
+}
+
+#endif // BLE_SVC_GATT_FAKE_H
@@ -0,0 +1,49 @@
+// nimble_port.h
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// Host stand-in for the NimBLE port event queue and mutex. Events put on the
+// default queue run from NimBLEFake::runHostTasks() instead of the host task.
+// Everything runs on one thread, so the mutex only counts its recursion.
+
+#ifndef NIMBLE_PORT_FAKE_H
+#define NIMBLE_PORT_FAKE_H
+
+#include <stdint.h>
+
+typedef uint32_t ble_npl_time_t;
+#define BLE_NPL_TIME_FOREVER UINT32_MAX
+
+typedef enum ble_npl_error {
+    BLE_NPL_OK = 0,
+    BLE_NPL_EINVAL = 2,
+    BLE_NPL_ERROR = 6,
+} ble_npl_error_t;
+
+struct ble_npl_event;
+typedef void ble_npl_event_fn(struct ble_npl_event* event);
+
+struct ble_npl_event {
+    ble_npl_event_fn* fn;
+    void* arg;
+    bool queued;
+};
+
+struct ble_npl_eventq {
+    int id;
+};
+
+struct ble_npl_mutex {
+    uint16_t depth;     // recursive, like the FreeRTOS port
+};
+
+extern "C" {
+struct ble_npl_eventq* nimble_port_get_dflt_eventq(void);
+void ble_npl_event_init(struct ble_npl_event* event, ble_npl_event_fn* fn, void* arg);
+void ble_npl_eventq_put(struct ble_npl_eventq* eventq, struct ble_npl_event* event);
+ble_npl_error_t ble_npl_mutex_init(struct ble_npl_mutex* mutex);
+ble_npl_error_t ble_npl_mutex_pend(struct ble_npl_mutex* mutex, ble_npl_time_t timeout);
+ble_npl_error_t ble_npl_mutex_release(struct ble_npl_mutex* mutex);
+}
+
+#endif // NIMBLE_PORT_FAKE_H
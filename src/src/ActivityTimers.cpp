@@ -0,0 +1,94 @@
+// ActivityTimers.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "ActivityTimers.h"
+#include "Hal.h"
+
+// Constructor
+ActivityTimers::ActivityTimers(uint32_t idleTimeout, uint32_t advertisingTimeout, uint32_t connIdleTimeout) {
+    this->idleTimeout = idleTimeout;
+    this->advertisingTimeout = advertisingTimeout;
+    this->connIdleTimeout = connIdleTimeout;
+    lastActivityTime = 0;
+    advertisingStartTime = 0;
+    inactive = false;
+}
+
+// Restart the idle timeouts
+void ActivityTimers::markActivity(uint32_t now) {
+    lastActivityTime = now;
+}
+
+// Restart the advertising timeout
+void ActivityTimers::markAdvertisingStart(uint32_t now) {
+    advertisingStartTime = now;
+}
+
+// Leave the connected-inactive mode
+void ActivityTimers::leaveInactive() {
+    inactive = false;
+}
+
+// Find the timeouts that ran out
+uint8_t ActivityTimers::check(uint32_t now, bool idle, bool connected, bool advertising, bool externalPower) {
+    // Idle for too long, never on external power. Standby may block for hours, so the caller
+    // has to check again with a fresh time before acting on anything else
+    if (idle && !externalPower && now - lastActivityTime > idleTimeout) {
+        return ACTION_STANDBY;
+    }
+
+    uint8_t actions = 0;
+
+    // Connected but not playing, on external power too so the link still relaxes
+    if (connected && !inactive && now - lastActivityTime > connIdleTimeout) {
+        inactive = true;
+        actions |= ACTION_ENTER_INACTIVE;
+    }
+
+    // Advertising for too long
+    if (advertising && now - advertisingStartTime > advertisingTimeout) {
+        actions |= ACTION_STOP_ADVERTISING;
+    }
+
+    return actions;
+}
+
+// Check if the connected-inactive mode is on
+bool ActivityTimers::isInactive() const {
+    return inactive;
+}
+
+// Get the time of the last activity
+uint32_t ActivityTimers::getLastActivityTime() const {
+    return lastActivityTime;
+}
+
+// Get the time advertising started
+uint32_t ActivityTimers::getAdvertisingStartTime() const {
+    return advertisingStartTime;
+}
+
+// Light sleep between controller reads until any button is pressed
+bool ActivityTimers::waitForPress(NesController& pad, uint32_t timeout, uint32_t pollInterval,
+                                  std::function<void(uint32_t milliseconds)> sleep) {
+    uint32_t startTime = Hal::millis();
+    while (true) {
+        pad.read();
+        if (pad.isAnyPressed()) {
+            break;
+        }
+        if (Hal::millis() - startTime > timeout) {
+            return false;
+        }
+        sleep(pollInterval);
+    }
+
+    // The button that woke the pad is no gesture, and the timers start from the wake
+    pad.resetGestures();
+    uint32_t now = Hal::millis();
+    markActivity(now);
+    markAdvertisingStart(now);
+    inactive = false;
+    return true;
+}
@@ -4,6 +4,12 @@
 
 #include "BLEJoystick.h"
 #include <Arduino.h>
+#include <Preferences.h>
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+#include "services/gatt/ble_svc_gatt.h"
+#else
+#include "nimble/nimble/host/services/gatt/include/services/gatt/ble_svc_gatt.h"
+#endif
 
 // HID Report Descriptor for a joystick
 const uint8_t BLEJoystick::hidReportDescriptor[] = {
@@ -60,18 +66,131 @@ const uint8_t BLEJoystick::hidReportDescriptor[] = {
     0xC0               // End Collection
 };
 
+// Readable name of a BLE_GAP_LE_PHY_* value
+static const char* phyName(uint8_t phy) {
+    switch (phy) {
+        case BLE_GAP_LE_PHY_2M: return "2M";
+        case BLE_GAP_LE_PHY_CODED: return "Coded";
+        default: return "1M";
+    }
+}
+
+// Approximate radio TX current per power level from TX_POWER_MIN up, mA
+static const float txPowerCurrent[] = { 13.5f, 14.5f, 15.5f, 16.5f, 18.0f, 20.0f, 23.0f, 26.5f };
+
+// Radio TX time per connection event (empty PDU) and per input report notification at 1M PHY
+static const uint32_t EMPTY_PDU_AIRTIME = 80;   // microseconds
+static const uint32_t REPORT_PDU_AIRTIME = 176; // microseconds
+
+// Diagnostic service and characteristic
+static const char* DIAGNOSTICS_SERVICE_UUID = "f0b7a5c0-3b1e-4c8a-9d2e-4e4553000000";
+static const char* DIAGNOSTICS_CHARACTERISTIC_UUID = "f0b7a5c0-3b1e-4c8a-9d2e-4e4553000001";
+static const char* ENERGY_CHARACTERISTIC_UUID = "f0b7a5c0-3b1e-4c8a-9d2e-4e4553000002";
+
+// Battery Power State (0x2A1A) fields: present, discharging, charging and level, two bits each
+static const uint8_t POWER_STATE_PRESENT = 0x03;
+static const uint8_t POWER_STATE_NOT_DISCHARGING = 0x08;
+static const uint8_t POWER_STATE_DISCHARGING = 0x0C;
+static const uint8_t POWER_STATE_NOT_CHARGING = 0x20;
+static const uint8_t POWER_STATE_CHARGING = 0x30;
+static const uint8_t POWER_STATE_GOOD_LEVEL = 0x80;
+static const uint8_t POWER_STATE_CRITICAL = 0xC0;
+
+// LE Secure Connections key pair precomputation states
+static const uint8_t PAIRING_KEY_PENDING = 0;
+static const uint8_t PAIRING_KEY_GENERATING = 1;
+static const uint8_t PAIRING_KEY_READY = 2;
+static const uint8_t PAIRING_KEY_SKIPPED = 3;    // a new host came first or generation failed, pairing makes it
+
+// HCI reason for a supervision timeout as reported in GAP disconnect events
+static const int SUPERVISION_TIMEOUT_REASON = BLE_HS_ERR_HCI_BASE + 0x08;
+
+// Default advertising schedule: fast burst for discovery, then progressively slower
+static const BLEJoystick::AdvertisingTier defaultAdvertisingSchedule[] = {
+    { 5, 32, 48 },          // 5 s at 20-30 ms
+    { 10, 244, 338 },       // 10 s at 152.5-211.25 ms
+    { 0, 668, 876 },        // 417.5-547.5 ms until timeout
+};
+
+// Instance receiving GAP events
+BLEJoystick* BLEJoystick::instance = nullptr;
+
 // Constructor implementation
-BLEJoystick::BLEJoystick(std::string deviceName) {
+BLEJoystick::BLEJoystick(std::string deviceName, const RetainedState* retained) {
     deviceState = DEVICE_STOPPED;
     batteryLevel = 100;
+    instance = this;
+    
+    // Initialize connected peers
+    memset(peers, 0, sizeof(peers));
+    peerCount = 0;
+    ble_npl_mutex_init(&peerMutex);
+    
+    // Initialize TX power control
+    autoTxPower = true;
+    txPowerLevel = TX_POWER_MAX;
+    txPowerLimit = TX_POWER_MAX;
+    txPowerHold = 0;
+    lastTxPowerSample = 0;
+    txEnergySaved = 0;
+    
+    // Initialize link telemetry
+    memset(linkHistory, 0, sizeof(linkHistory));
+    linkHistoryHead = 0;
+    linkHistoryCount = 0;
+    connectCount = 0;
+    disconnectCount = 0;
+    supervisionTimeouts = 0;
+    lastNotifyTime = 0;
+    notifyCount = 0;
+    firstPressLatency = 0;
+    firstPressEdge = 0;
+    firstPressPending = false;
+    
+    // Initialize HID suspend
+    suspended = false;
+    suspendStartTime = 0;
+    suspendedTime = 0;
+    
+    // Initialize pairing key precomputation
+    pairingKeyState = PAIRING_KEY_PENDING;
+    pairingKeyTime = 0;
+    lastPairingTime = 0;
+    
+    // Initialize reconnect state
+    fastReconnect = true;
+    advertising = false;
+    directedAdvertising = false;
+    memset(hostSlots, 0, sizeof(hostSlots));
+    activeHostSlot = 0;
+    hostSlotsDirty = false;
+    advertisingStartTime = 0;
+    lastConnectTime = 0;
+    lastConnectDirected = false;
+    
+    // Initialize advertising schedule
+    advTierCount = 0;
+    advTier = 0;
+    advTierStartTime = 0;
+    lastConnectTier = 0;
+    setAdvertisingSchedule(defaultAdvertisingSchedule,
+                           sizeof(defaultAdvertisingSchedule) / sizeof(defaultAdvertisingSchedule[0]));
     
     // Initialize HID report data
     memset(buttons, 0, sizeof(buttons));
     memset(axes, 0, sizeof(axes));
     hat = 0;
+    memset(report, 0, sizeof(report));
+    tapDelivery = true;
+    minTapDuration = MIN_TAP_DURATION;
     
     // Initialize BLE
     NimBLEDevice::init(deviceName);
+    NimBLEDevice::setCustomGapHandler(handleGapEvent);
+    NimBLEDevice::setPower(TX_POWER_MAX);
+    
+    // Prefer 2M PHY for all connections, the controller falls back to 1M if the peer lacks it
+    ble_gap_set_prefered_default_le_phy(BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_2M_MASK);
     
     // Set security
     NimBLEDevice::setSecurityAuth(BLE_SM_PAIR_AUTHREQ_BOND | BLE_SM_PAIR_AUTHREQ_MITM | BLE_SM_PAIR_AUTHREQ_SC);
@@ -83,6 +202,8 @@ BLEJoystick::BLEJoystick(std::string deviceName) {
     pServer->advertiseOnDisconnect(false); // Turn off auto-advertising on disconnect
     
     // Create HID device
+    // Attributes are created in a fixed order so handles stay the same across boots,
+    // new ones go after the existing ones and bump GATT_LAYOUT_VERSION
     pHidDevice = new NimBLEHIDDevice(pServer);
     pHidDevice->reportMap((uint8_t*)hidReportDescriptor, sizeof(hidReportDescriptor));
     
@@ -92,6 +213,13 @@ BLEJoystick::BLEJoystick(std::string deviceName) {
     // Create battery service
     pBatteryCharacteristic = pHidDevice->batteryLevel();
     
+    // Battery Power State, so hosts can tell charging from discharging
+    pPowerStateCharacteristic = pHidDevice->batteryService()->createCharacteristic(
+        NimBLEUUID((uint16_t)0x2A1A), NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY);
+    
+    // Follow host suspend requests
+    pHidDevice->hidControl()->setCallbacks(new HidControlCallbacks(this));
+    
     // Start device
     pHidDevice->startServices();
     
@@ -100,8 +228,87 @@ BLEJoystick::BLEJoystick(std::string deviceName) {
     pHidDevice->pnp(0x01, 0x02E5, 0xABCD, 0x0110);
     pHidDevice->hidInfo(0x00, 0x01);
     
-    // Set initial battery level
+    // Create diagnostic service
+    NimBLEService* pDiagnosticsService = pServer->createService(DIAGNOSTICS_SERVICE_UUID);
+    pDiagnosticsCharacteristic = pDiagnosticsService->createCharacteristic(DIAGNOSTICS_CHARACTERISTIC_UUID,
+                                                                           NIMBLE_PROPERTY::READ);
+    pDiagnosticsCharacteristic->setCallbacks(new DiagnosticsCallbacks(this));
+    pEnergyCharacteristic = pDiagnosticsService->createCharacteristic(ENERGY_CHARACTERISTIC_UUID,
+                                                                      NIMBLE_PROPERTY::READ);
+    pDiagnosticsService->start();
+    
+    // Build advertising payload once
+    buildAdvertisingData(deviceName);
+    
+    // Set initial battery level and power state
+    externalPower = false;
+    charging = false;
+    batteryCritical = false;
+    powerState = 0;
     setBatteryLevel(100);
+    
+    // Restore bonded hosts for fast reconnect, straight from RTC memory after deep sleep
+    if (retained != nullptr) {
+        memcpy(hostSlots, retained->hostSlots, sizeof(hostSlots));
+        activeHostSlot = retained->activeHostSlot < HOST_SLOTS ? retained->activeHostSlot : 0;
+        connectCount = retained->connectCount;
+        disconnectCount = retained->disconnectCount;
+        supervisionTimeouts = retained->supervisionTimeouts;
+        suspendedTime = retained->suspendedTime;
+    } else {
+        loadHostSlots();
+    }
+    
+    // Register the GATT database now and tell bonded hosts if it changed
+    pServer->start();
+    checkGattLayout();
+}
+
+// Generate the P-256 key pair NimBLE keeps for Secure Connections pairing, once, from the loop
+// so the NimBLE host task keeps serving the radio meanwhile
+void BLEJoystick::generatePairingKey() {
+    // Pairing generates the pair itself on the host task. Claiming the state keeps the two apart:
+    // a new host that connected first leaves it to pairing, one that pairs meanwhile waits
+    uint8_t expected = PAIRING_KEY_PENDING;
+    if (!pairingKeyState.compare_exchange_strong(expected, PAIRING_KEY_GENERATING)) {
+        return;
+    }
+    
+    // Out-of-band data generation creates and caches the key pair as a side effect, without any lock
+    uint32_t start = micros();
+    ble_sm_sc_oob_data oobData;
+    int rc = ble_sm_sc_oob_generate_data(&oobData);
+    pairingKeyTime = micros() - start;
+    pairingKeyState = rc == 0 ? PAIRING_KEY_READY : PAIRING_KEY_SKIPPED;
+    
+    if (rc == 0) {
+        Serial.printf("Pairing key pair ready in %lu us\n", (unsigned long)pairingKeyTime);
+    } else {
+        Serial.printf("Pairing key pair generation failed (%d), will generate on first pairing\n", rc);
+    }
+}
+
+// Check if the pairing key pair has been generated
+bool BLEJoystick::isPairingKeyReady() const {
+    return pairingKeyState == PAIRING_KEY_READY;
+}
+
+// Hold a pairing on the host task back until the loop has generated the key pair, only
+// needed by a host that pairs within the few milliseconds the generation takes
+void BLEJoystick::waitForPairingKey() {
+    while (pairingKeyState == PAIRING_KEY_GENERATING) {
+        delay(1);
+    }
+}
+
+// Get time spent generating the pairing key pair
+uint32_t BLEJoystick::getPairingKeyTime() const {
+    return pairingKeyTime;
+}
+
+// Get time from link-up to bonding for the last new host
+uint32_t BLEJoystick::getLastPairingTime() const {
+    return lastPairingTime;
 }
 
 // Start the BLE device
@@ -123,33 +330,382 @@ void BLEJoystick::stop() {
 // Start advertising
 void BLEJoystick::startAdvertising() {
     if (deviceState == DEVICE_IDLE) {
-        NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
-        pAdvertising->setAppearance(HID_GAMEPAD);
-        pAdvertising->addServiceUUID(pHidDevice->hidService()->getUUID());
-        pAdvertising->setScanResponse(true);
-        pAdvertising->start();
+        advertisingStartTime = millis();
+        directedAdvertising = false;
+        
+        const HostSlot& host = hostSlots[activeHostSlot];
+        NimBLEAddress lastHost(host.addr);
+        if (fastReconnect && host.valid && NimBLEDevice::isBonded(lastHost)) {
+            // Directed advertising to the active host, falls back to general advertising on timeout.
+            // This is low duty cycle directed advertising at the 20 ms minimum interval: NimBLEAdvertising
+            // doesn't expose high_duty_cycle, and starting ble_gap_adv_start() ourselves would hand the
+            // connection to our callback instead of NimBLEServer, which tracks peers and runs the server
+            // callbacks. Over its 1 s the host still sees 50 directed PDUs, enough for a scanner running
+            // the usual 30 ms of every 60 ms to catch one within the first few, and general advertising
+            // takes over well inside the advertising timeout.
+            NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+            pAdvertising->setAdvertisementType(BLE_GAP_CONN_MODE_DIR);
+            pAdvertising->setScanResponse(false);
+            pAdvertising->setMinInterval(DIRECTED_ADV_INTERVAL);
+            pAdvertising->setMaxInterval(DIRECTED_ADV_INTERVAL);
+            directedAdvertising = pAdvertising->start(DIRECTED_ADV_DURATION, onAdvertisingComplete, &lastHost);
+            advertising = directedAdvertising;
+            if (directedAdvertising) {
+                Serial.printf("Reconnecting to host %u (%s) ...\n", activeHostSlot + 1, lastHost.toString().c_str());
+            }
+        }
+        
+        if (!directedAdvertising) {
+            startAdvertisingTier(0);
+        }
         
         updateDeviceState(DEVICE_ADVERTISING);
+    } else if (deviceState == DEVICE_CONNECTED && !advertising && peerCount < MAX_PEERS) {
+        // Let another host join while staying connected
+        advertisingStartTime = millis();
+        directedAdvertising = false;
+        startAdvertisingTier(0);
     }
 }
 
 // Stop advertising
 void BLEJoystick::stopAdvertising() {
-    if (deviceState == DEVICE_ADVERTISING) {
+    if (advertising) {
         NimBLEDevice::getAdvertising()->stop();
+        endAdvertisingTier();
+        advertising = false;
+        directedAdvertising = false;
+        printAdvertisingStats();
+    }
+    
+    if (deviceState == DEVICE_ADVERTISING) {
         updateDeviceState(DEVICE_IDLE);
     }
 }
 
+// Check if advertising, including for an additional host while connected
+bool BLEJoystick::isAdvertising() const {
+    return advertising;
+}
+
+// Build advertising and scan response payloads
+void BLEJoystick::buildAdvertisingData(const std::string& deviceName) {
+    advData.setFlags(BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP);
+    advData.setAppearance(HID_GAMEPAD);
+    advData.setCompleteServices(pHidDevice->hidService()->getUUID());
+    scanResponseData.setName(deviceName);
+    
+    NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+    pAdvertising->setAdvertisementData(advData);
+    pAdvertising->setScanResponseData(scanResponseData);
+}
+
+// Undirected, discoverable advertising at the intervals of a schedule tier
+void BLEJoystick::startAdvertisingTier(uint8_t tier) {
+    advTier = tier;
+    advTierStartTime = millis();
+    
+    NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+    pAdvertising->setAdvertisementType(BLE_GAP_CONN_MODE_UND);
+    pAdvertising->setMinInterval(advTiers[tier].minInterval);
+    pAdvertising->setMaxInterval(advTiers[tier].maxInterval);
+    pAdvertising->setScanResponse(true);
+    advertising = pAdvertising->start(advTiers[tier].duration, onAdvertisingComplete);
+}
+
+// Account for the time spent in the current advertising tier
+void BLEJoystick::endAdvertisingTier() {
+    if (directedAdvertising || advTier >= advTierCount) {
+        return;
+    }
+    
+    AdvertisingTierStats& stats = advTierStats[advTier];
+    uint32_t elapsed = millis() - advTierStartTime;
+    
+    // Advertising events are spaced by the interval plus a 0-10 ms random delay
+    uint32_t eventPeriod = (advTiers[advTier].minInterval + advTiers[advTier].maxInterval) * 625 / 2 + 5000;
+    uint32_t events = (uint32_t)((uint64_t)elapsed * 1000 / eventPeriod);
+    
+    stats.time += elapsed;
+    stats.events += events;
+    stats.charge += events * ADV_EVENT_CHARGE;
+    advTierStartTime = millis();
+}
+
+// Directed advertising or a schedule tier timed out without a connection
+void BLEJoystick::onAdvertisingComplete(NimBLEAdvertising*) {
+    BLEJoystick* device = instance;
+    if (device == nullptr || !device->advertising) {
+        return;
+    }
+    
+    if (device->directedAdvertising) {
+        Serial.println("Last host did not respond, advertising to all ...");
+        device->directedAdvertising = false;
+        device->startAdvertisingTier(0);
+    } else if (device->advTier + 1 < device->advTierCount) {
+        device->endAdvertisingTier();
+        device->startAdvertisingTier(device->advTier + 1);
+    } else {
+        device->endAdvertisingTier();
+        device->advertising = false;
+    }
+}
+
+// Set the advertising schedule, tiers run in order until advertising stops
+void BLEJoystick::setAdvertisingSchedule(const AdvertisingTier* tiers, uint8_t count) {
+    advTierCount = count < MAX_ADV_TIERS ? count : MAX_ADV_TIERS;
+    for (uint8_t i = 0; i < advTierCount; i++) {
+        advTiers[i] = tiers[i];
+    }
+    memset(advTierStats, 0, sizeof(advTierStats));
+}
+
+// Get the advertising tier in use
+uint8_t BLEJoystick::getAdvertisingTier() const {
+    return directedAdvertising ? ADV_TIER_DIRECTED : advTier;
+}
+
+// Get the advertising tier of the last connection
+uint8_t BLEJoystick::getLastConnectTier() const {
+    return lastConnectTier;
+}
+
+// Get accumulated statistics for an advertising tier
+const BLEJoystick::AdvertisingTierStats& BLEJoystick::getAdvertisingTierStats(uint8_t tier) const {
+    return advTierStats[tier < advTierCount ? tier : 0];
+}
+
+// Print discovery latency and energy for each advertising tier
+void BLEJoystick::printAdvertisingStats() const {
+    Serial.println("=== ADVERTISING STATS ===");
+    for (uint8_t i = 0; i < advTierCount; i++) {
+        const AdvertisingTierStats& stats = advTierStats[i];
+        Serial.printf("  Tier %u (%.1f-%.1f ms): %lu ms, %lu events, %.2f uAh, %u connects",
+                      i, advTiers[i].minInterval * 0.625, advTiers[i].maxInterval * 0.625,
+                      (unsigned long)stats.time, (unsigned long)stats.events, stats.charge / 3600.0,
+                      stats.connects);
+        if (stats.connects > 0) {
+            Serial.printf(", avg %lu ms to connect", (unsigned long)(stats.connectTime / stats.connects));
+        }
+        Serial.println();
+    }
+    Serial.println("=========================");
+}
+
+// Enable or disable directed advertising to the last host
+void BLEJoystick::setFastReconnect(bool enabled) {
+    fastReconnect = enabled;
+}
+
+// Check if directed advertising is in progress
+bool BLEJoystick::isReconnecting() const {
+    return deviceState == DEVICE_ADVERTISING && directedAdvertising;
+}
+
+// Get time from advertising start to the last connection
+uint32_t BLEJoystick::getLastConnectTime() const {
+    return lastConnectTime;
+}
+
+// Check if the last connection came from directed advertising
+bool BLEJoystick::wasLastConnectDirected() const {
+    return lastConnectDirected;
+}
+
+// Switch to a host slot and reconnect to it
+void BLEJoystick::selectHost(uint8_t slot) {
+    if (slot >= HOST_SLOTS) {
+        return;
+    }
+    
+    Serial.printf("Switching to host %u%s\n", slot + 1, hostSlots[slot].valid ? "" : " (not paired)");
+    activeHostSlot = slot;
+    saveHostSlots();
+    
+    if (deviceState == DEVICE_CONNECTED) {
+        disconnect();
+    } else {
+        stopAdvertising();
+    }
+    startAdvertising();
+}
+
+// Switch to the next host slot
+void BLEJoystick::nextHost() {
+    selectHost((activeHostSlot + 1) % HOST_SLOTS);
+}
+
+// Remove a host slot and its bond
+void BLEJoystick::forgetHost(uint8_t slot) {
+    if (slot >= HOST_SLOTS || !hostSlots[slot].valid) {
+        return;
+    }
+    
+    NimBLEDevice::deleteBond(NimBLEAddress(hostSlots[slot].addr));
+    memset(&hostSlots[slot], 0, sizeof(HostSlot));
+    saveHostSlots();
+}
+
+// Get the active host slot
+uint8_t BLEJoystick::getActiveHost() const {
+    return activeHostSlot;
+}
+
+// Check if a host slot holds a bonded host
+bool BLEJoystick::hasHost(uint8_t slot) const {
+    return slot < HOST_SLOTS && hostSlots[slot].valid;
+}
+
+// Compare the GATT layout with the one bonded hosts have cached
+void BLEJoystick::checkGattLayout() {
+    // Fold the report map into the version, hosts cache it with the handles
+    uint32_t layout = 2166136261u ^ GATT_LAYOUT_VERSION;
+    for (size_t i = 0; i < sizeof(hidReportDescriptor); i++) {
+        layout = (layout ^ hidReportDescriptor[i]) * 16777619u;
+    }
+    
+    Preferences prefs;
+    prefs.begin("bt-nes", false);
+    uint32_t storedLayout = prefs.getUInt("gattLayout", 0);
+    if (storedLayout != layout) {
+        // Queued for bonded hosts and indicated when they next connect
+        if (storedLayout != 0) {
+            Serial.println("GATT layout changed, indicating Service Changed to bonded hosts");
+            ble_svc_gatt_changed(0x0001, 0xFFFF);
+        }
+        prefs.putUInt("gattLayout", layout);
+    }
+    prefs.end();
+}
+
+// Load host slots from flash
+void BLEJoystick::loadHostSlots() {
+    Preferences prefs;
+    prefs.begin("bt-nes", true);
+    if (prefs.getBytes("hosts", hostSlots, sizeof(hostSlots)) != sizeof(hostSlots)) {
+        memset(hostSlots, 0, sizeof(hostSlots));
+    }
+    activeHostSlot = prefs.getUChar("activeHost", 0);
+    prefs.end();
+    
+    if (activeHostSlot >= HOST_SLOTS) {
+        activeHostSlot = 0;
+    }
+    
+    // Drop hosts whose bond was removed
+    for (uint8_t i = 0; i < HOST_SLOTS; i++) {
+        if (hostSlots[i].valid && !NimBLEDevice::isBonded(NimBLEAddress(hostSlots[i].addr))) {
+            memset(&hostSlots[i], 0, sizeof(HostSlot));
+        }
+    }
+}
+
+// Flush host slots and copy the state worth keeping across deep sleep
+void BLEJoystick::retainState(RetainedState& state) {
+    if (hostSlotsDirty) {
+        saveHostSlots();
+    }
+    
+    memcpy(state.hostSlots, hostSlots, sizeof(hostSlots));
+    state.activeHostSlot = activeHostSlot;
+    state.connectCount = connectCount;
+    state.disconnectCount = disconnectCount;
+    state.supervisionTimeouts = supervisionTimeouts;
+    state.suspendedTime = getSuspendedTime();
+}
+
+// Save host slots to flash
+void BLEJoystick::saveHostSlots() {
+    Preferences prefs;
+    prefs.begin("bt-nes", false);
+    prefs.putBytes("hosts", hostSlots, sizeof(hostSlots));
+    prefs.putUChar("activeHost", activeHostSlot);
+    prefs.end();
+    hostSlotsDirty = false;
+}
+
+// Find the slot holding a host address
+uint8_t BLEJoystick::findHostSlot(const ble_addr_t& addr) const {
+    for (uint8_t i = 0; i < HOST_SLOTS; i++) {
+        if (hostSlots[i].valid && memcmp(&hostSlots[i].addr, &addr, sizeof(addr)) == 0) {
+            return i;
+        }
+    }
+    return NO_HOST_SLOT;
+}
+
+// Store a bonded host, a new one goes to a free slot or replaces the least recently used host
+// that is not connected, so adding a host never drops the bond of one in use
+uint8_t BLEJoystick::assignHostSlot(const ble_addr_t& addr) {
+    uint8_t slot = findHostSlot(addr);
+    if (slot == NO_HOST_SLOT) {
+        // Prefer the selected slot when it is free
+        if (!hostSlots[activeHostSlot].valid) {
+            slot = activeHostSlot;
+        }
+        for (uint8_t i = 0; i < HOST_SLOTS && slot == NO_HOST_SLOT; i++) {
+            if (!hostSlots[i].valid) {
+                slot = i;
+            }
+        }
+        for (uint8_t i = 0; i < HOST_SLOTS; i++) {
+            if (hostSlots[i].valid && !isHostConnected(i) &&
+                (slot == NO_HOST_SLOT || (hostSlots[slot].valid && hostSlots[i].age > hostSlots[slot].age))) {
+                slot = i;
+            }
+        }
+        if (slot == NO_HOST_SLOT) {
+            Serial.println("No host slot free, not remembering the new host");
+            return NO_HOST_SLOT;
+        }
+        
+        if (hostSlots[slot].valid) {
+            Serial.printf("Replacing host %u\n", slot + 1);
+            NimBLEDevice::deleteBond(NimBLEAddress(hostSlots[slot].addr));
+        }
+        memset(&hostSlots[slot], 0, sizeof(HostSlot));
+        hostSlots[slot].addr = addr;
+        hostSlots[slot].valid = 1;
+        hostSlots[slot].age = HOST_SLOTS;
+        Serial.printf("Paired host %u\n", slot + 1);
+    }
+    
+    // Age the hosts used more recently than this one
+    for (uint8_t i = 0; i < HOST_SLOTS; i++) {
+        if (i != slot && hostSlots[i].valid && hostSlots[i].age < hostSlots[slot].age) {
+            hostSlots[i].age++;
+        }
+    }
+    hostSlots[slot].age = 0;
+    
+    activeHostSlot = slot;
+    saveHostSlots();
+    return slot;
+}
+
+// Check if the host in a slot is connected
+bool BLEJoystick::isHostConnected(uint8_t slot) const {
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (peers[i].hostSlot == slot) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Disconnect any active BLE connections
 void BLEJoystick::disconnect() {
     if (deviceState == DEVICE_CONNECTED && pServer != nullptr) {
+        // Stop advertising for additional hosts
+        stopAdvertising();
+        
         // First set the state to IDLE to prevent any automatic advertising
         updateDeviceState(DEVICE_IDLE);
         
         // Disconnect all connected clients
         size_t peersNum = this->pServer->getConnectedCount();
-        for (int i = 0; i < peersNum; i++) {
+        for (size_t i = 0; i < peersNum; i++) {
             uint16_t connID = this->pServer->getPeerInfo(i).getConnHandle();
             this->pServer->disconnect(connID);
         }
@@ -202,15 +758,15 @@ void BLEJoystick::setHat(uint8_t hatDirection) {
 // Notify HID report to connected client
 void BLEJoystick::notifyHIDReport() {
     if (deviceState == DEVICE_CONNECTED) {
-        uint8_t report[5];  // Increased size to include Y axis
-        
         report[0] = buttons[0];
         report[1] = buttons[1];
         report[2] = (hat & 0x0F);
         report[3] = axes[0]; // X axis
         report[4] = axes[1]; // Y axis
         
-        // Debug output in a human-readable format
+#ifdef HID_REPORT_DEBUG
+        // Debug output in a human-readable format, build with -DHID_REPORT_DEBUG. Several hundred
+        // bytes of blocking prints per report, far more than the rest of the report path takes
         Serial.println("=== HID REPORT DEBUG ===");
         
         for (int i = 0; i < 8; i++) {
@@ -257,22 +813,188 @@ void BLEJoystick::notifyHIDReport() {
         }
         Serial.println("]");
         Serial.println("======================");
+#endif
+        
+        lockPeers();
+        
+        // Local input brings every host out of suspend
+        if (suspended) {
+            for (uint8_t i = 0; i < peerCount; i++) {
+                peers[i].suspended = false;
+            }
+            updateSuspendState();
+        }
         
+        // Pack once, then queue and notify each subscribed peer on its own
         pInputCharacteristic->setValue(report, sizeof(report));
-        pInputCharacteristic->notify();
+        bool queued = false;
+        for (uint8_t i = 0; i < peerCount; i++) {
+            if (peers[i].subscribed) {
+                queued = true;
+                queueReport(peers[i]);
+                sendReports(peers[i]);
+            }
+            
+            // Gameplay resumed, tighten the link again
+            if (peers[i].connProfile == CONN_PROFILE_IDLE) {
+                requestConnParams(peers[i], CONN_PROFILE_ACTIVE);
+            }
+        }
+        
+        // No host took the press, a later report would time something else
+        if (!queued) {
+            firstPressPending = false;
+        }
+        
+        unlockPeers();
+    }
+}
+
+// Retry queued reports for peers that were congested
+void BLEJoystick::flushReports() {
+    lockPeers();
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (peers[i].subscribed && peers[i].queueCount > 0) {
+            sendReports(peers[i]);
+        }
+    }
+    unlockPeers();
+}
+
+// Queue every distinct state in order, or keep only the latest one
+void BLEJoystick::setTapDelivery(bool enabled, uint16_t minDuration) {
+    tapDelivery = enabled;
+    minTapDuration = minDuration;
+}
+
+// Add the packed report to a peer's queue
+void BLEJoystick::queueReport(PeerLink& peer) {
+    uint32_t now = millis();
+    
+    // Latest-state delivery, or no room left: the newest queued state gives way
+    if (peer.queueCount > 0 && (!tapDelivery || peer.queueCount == REPORT_QUEUE_SIZE)) {
+        uint8_t tail = (peer.queueHead + peer.queueCount - 1) % REPORT_QUEUE_SIZE;
+        if (tapDelivery) {
+            if (now - peer.queueTime[tail] < minTapDuration) {
+                peer.statesMerged++;
+            } else {
+                peer.statesDropped++;
+            }
+        }
+        memcpy(peer.queue[tail], report, REPORT_SIZE);
+        peer.queueTime[tail] = now;
+        return;
+    }
+    
+    uint8_t slot = (peer.queueHead + peer.queueCount) % REPORT_QUEUE_SIZE;
+    memcpy(peer.queue[slot], report, REPORT_SIZE);
+    peer.queueTime[slot] = now;
+    peer.queueCount++;
+}
+
+// Notify queued reports to one peer in order, stopping at the first the stack can't take
+void BLEJoystick::sendReports(PeerLink& peer) {
+    while (peer.queueCount > 0) {
+        // A peer at its cap waits for NOTIFY_TX, the rest of the buffer pool stays with the other peers
+        if (peer.txInFlight >= MAX_TX_IN_FLIGHT) {
+            peer.notifyDeferred++;
+            break;
+        }
+        
+        // Counted before the call, in case the stack reports the send from inside it
+        peer.txInFlight++;
+        struct os_mbuf* om = ble_hs_mbuf_from_flat(peer.queue[peer.queueHead], REPORT_SIZE);
+        int rc = om != nullptr ? ble_gattc_notify_custom(peer.connHandle, pInputCharacteristic->getHandle(), om)
+                               : BLE_HS_ENOMEM;
+        if (rc != 0) {
+            if (peer.txInFlight > 0) {
+                peer.txInFlight--;
+            }
+            peer.notifyFailed++;
+            if (rc == BLE_HS_ENOMEM) {
+                peer.mbufExhausted++;
+            }
+            break;
+        }
+        
+        peer.notifySent++;
+        notifyCount++;
+        lastNotifyTime = millis();
+        if (peer.queueCount > 1) {
+            peer.statesRecovered++;
+        }
+        peer.queueHead = (peer.queueHead + 1) % REPORT_QUEUE_SIZE;
+        peer.queueCount--;
+        
+        // The first press out of the connected-inactive mode reached the stack, a congested host
+        // holds it in the queue and the flush that sends it counts too
+        if (firstPressPending) {
+            firstPressPending = false;
+            uint32_t latency = micros() - firstPressEdge;
+            firstPressLatency = max<uint32_t>(firstPressLatency, min<uint32_t>((latency + 999) / 1000, UINT16_MAX));
+            Serial.printf("First press queued %lu us after the pad read, worst %u ms\n",
+                          (unsigned long)latency, firstPressLatency);
+        }
+        
+        if (peer.firstReportTime == 0) {
+            peer.firstReportTime = max<uint32_t>(1, millis() - peer.linkUpTime);
+            Serial.printf("First report %lu ms after link-up (encrypted at %lu ms, subscribed at %lu ms)\n",
+                          (unsigned long)peer.firstReportTime, (unsigned long)peer.encryptTime,
+                          (unsigned long)peer.subscribeTime);
+        }
     }
 }
 
 // Set battery level
 void BLEJoystick::setBatteryLevel(uint8_t level) {
     batteryLevel = level > 100 ? 100 : level;
+    updatePowerState();
+}
+
+// Set charger state
+void BLEJoystick::setPowerState(bool externalPower, bool charging) {
+    this->externalPower = externalPower;
+    this->charging = externalPower && charging;
+    updatePowerState();
+}
+
+// Flag the battery as critically low
+void BLEJoystick::setBatteryCritical(bool critical) {
+    batteryCritical = critical;
+    updatePowerState();
+}
+
+// Get the Battery Power State value
+uint8_t BLEJoystick::getPowerState() const {
+    return powerState;
+}
+
+// Rebuild the Battery Power State and notify it when it changes
+void BLEJoystick::updatePowerState() {
+    uint8_t state = POWER_STATE_PRESENT;
+    state |= externalPower ? POWER_STATE_NOT_DISCHARGING : POWER_STATE_DISCHARGING;
+    state |= charging ? POWER_STATE_CHARGING : POWER_STATE_NOT_CHARGING;
+    state |= batteryCritical && !externalPower ? POWER_STATE_CRITICAL : POWER_STATE_GOOD_LEVEL;
+    if (state == powerState) {
+        return;
+    }
+    
+    powerState = state;
+    pPowerStateCharacteristic->setValue(&powerState, 1);
+    if (deviceState == DEVICE_CONNECTED && !suspended) {
+        pPowerStateCharacteristic->notify();
+        notifyCount++;
+        lastNotifyTime = millis();
+    }
 }
 
 // Notify battery level to connected client
 void BLEJoystick::notifyBatteryLevel() {
-    if (deviceState == DEVICE_CONNECTED) {
+    if (deviceState == DEVICE_CONNECTED && !suspended) {
         pBatteryCharacteristic->setValue(&batteryLevel, 1);
         pBatteryCharacteristic->notify();
+        notifyCount++;
+        lastNotifyTime = millis();
     }
 }
 
@@ -286,6 +1008,614 @@ void BLEJoystick::setStateChangeCallback(std::function<void()> callback) {
     stateChangeCallback = callback;
 }
 
+// Get number of connected peers
+uint8_t BLEJoystick::getPeerCount() const {
+    return peerCount;
+}
+
+// Get a connected peer by index
+const BLEJoystick::PeerLink* BLEJoystick::getPeer(uint8_t index) const {
+    return index < peerCount ? &peers[index] : nullptr;
+}
+
+// Take the peer lock, the NimBLE host task adds and removes peers while the loop sends
+void BLEJoystick::lockPeers() {
+    ble_npl_mutex_pend(&peerMutex, BLE_NPL_TIME_FOREVER);
+}
+
+void BLEJoystick::unlockPeers() {
+    ble_npl_mutex_release(&peerMutex);
+}
+
+// Find a connected peer by connection handle
+BLEJoystick::PeerLink* BLEJoystick::findPeer(uint16_t connHandle) {
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (peers[i].connHandle == connHandle) {
+            return &peers[i];
+        }
+    }
+    return nullptr;
+}
+
+// Track a new connection
+BLEJoystick::PeerLink* BLEJoystick::addPeer(const ble_gap_conn_desc* desc) {
+    if (peerCount >= MAX_PEERS) {
+        return nullptr;
+    }
+    
+    PeerLink& peer = peers[peerCount++];
+    memset(&peer, 0, sizeof(peer));
+    peer.connHandle = desc->conn_handle;
+    peer.hostSlot = findHostSlot(desc->peer_id_addr);
+    peer.connProfile = CONN_PROFILE_NONE;
+    peer.connInterval = desc->conn_itvl;
+    peer.connLatency = desc->conn_latency;
+    peer.connTimeout = desc->supervision_timeout;
+    peer.txPhy = BLE_GAP_LE_PHY_1M;
+    peer.rxPhy = BLE_GAP_LE_PHY_1M;
+    peer.linkUpTime = millis();
+    return &peer;
+}
+
+// Stop tracking a closed connection
+void BLEJoystick::removePeer(uint16_t connHandle) {
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (peers[i].connHandle == connHandle) {
+            for (uint8_t j = i + 1; j < peerCount; j++) {
+                peers[j - 1] = peers[j];
+            }
+            peerCount--;
+            return;
+        }
+    }
+}
+
+// Request low latency connection parameters
+void BLEJoystick::requestActiveConnParams() {
+    lockPeers();
+    for (uint8_t i = 0; i < peerCount; i++) {
+        requestConnParams(peers[i], CONN_PROFILE_ACTIVE);
+    }
+    unlockPeers();
+}
+
+// Request power saving connection parameters
+void BLEJoystick::requestIdleConnParams() {
+    lockPeers();
+    for (uint8_t i = 0; i < peerCount; i++) {
+        requestConnParams(peers[i], CONN_PROFILE_IDLE);
+    }
+    unlockPeers();
+}
+
+// Get requested connection parameter profile
+uint8_t BLEJoystick::getConnProfile(uint8_t peer) const {
+    return peer < peerCount ? peers[peer].connProfile : CONN_PROFILE_NONE;
+}
+
+// Get negotiated connection interval
+uint16_t BLEJoystick::getConnInterval(uint8_t peer) const {
+    return peer < peerCount ? peers[peer].connInterval : 0;
+}
+
+// Get negotiated peripheral latency
+uint16_t BLEJoystick::getConnLatency(uint8_t peer) const {
+    return peer < peerCount ? peers[peer].connLatency : 0;
+}
+
+// Get negotiated supervision timeout
+uint16_t BLEJoystick::getConnTimeout(uint8_t peer) const {
+    return peer < peerCount ? peers[peer].connTimeout : 0;
+}
+
+// Get status of the last connection parameter update
+int BLEJoystick::getConnParamsStatus(uint8_t peer) const {
+    return peer < peerCount ? peers[peer].connParamsStatus : 0;
+}
+
+// Ask a host for the connection parameters of a profile
+void BLEJoystick::requestConnParams(PeerLink& peer, uint8_t profile) {
+    uint16_t minInterval = IDLE_CONN_INTERVAL_MIN;
+    uint16_t maxInterval = IDLE_CONN_INTERVAL_MAX;
+    uint16_t latency = IDLE_CONN_LATENCY;
+    uint16_t timeout = IDLE_CONN_TIMEOUT;
+    
+    if (profile == CONN_PROFILE_ACTIVE) {
+        minInterval = ACTIVE_CONN_INTERVAL_MIN;
+        maxInterval = ACTIVE_CONN_INTERVAL_MAX;
+        latency = ACTIVE_CONN_LATENCY;
+        timeout = ACTIVE_CONN_TIMEOUT;
+        
+        // Ask for the interval this host accepted last time so it settles in one exchange
+        if (peer.hostSlot != NO_HOST_SLOT && hostSlots[peer.hostSlot].connInterval > minInterval &&
+            hostSlots[peer.hostSlot].connInterval <= maxInterval) {
+            minInterval = hostSlots[peer.hostSlot].connInterval;
+        }
+    }
+    
+    peer.connProfile = profile;
+    Serial.printf("Requesting %s connection parameters: interval %.2f-%.2f ms, latency %u, timeout %u ms\n",
+                  profile == CONN_PROFILE_ACTIVE ? "active" : "idle",
+                  minInterval * 1.25, maxInterval * 1.25, latency, timeout * 10);
+    pServer->updateConnParams(peer.connHandle, minInterval, maxInterval, latency, timeout);
+}
+
+// Read the parameters currently in use on a connection
+void BLEJoystick::refreshConnParams(PeerLink& peer) {
+    ble_gap_conn_desc desc;
+    if (ble_gap_conn_find(peer.connHandle, &desc) == 0) {
+        peer.connInterval = desc.conn_itvl;
+        peer.connLatency = desc.conn_latency;
+        peer.connTimeout = desc.supervision_timeout;
+    }
+}
+
+// Get transmit PHY
+uint8_t BLEJoystick::getTxPhy(uint8_t peer) const {
+    return peer < peerCount ? peers[peer].txPhy : BLE_GAP_LE_PHY_1M;
+}
+
+// Get receive PHY
+uint8_t BLEJoystick::getRxPhy(uint8_t peer) const {
+    return peer < peerCount ? peers[peer].rxPhy : BLE_GAP_LE_PHY_1M;
+}
+
+// Get status of the last PHY update
+int BLEJoystick::getPhyStatus(uint8_t peer) const {
+    return peer < peerCount ? peers[peer].phyStatus : 0;
+}
+
+// Enable or disable RSSI-adaptive TX power
+void BLEJoystick::setAutoTxPower(bool enabled) {
+    autoTxPower = enabled;
+    if (!enabled) {
+        setTxPowerLevel(TX_POWER_MAX);
+    }
+}
+
+// Cap TX power, stepping down right away if above the cap
+void BLEJoystick::setTxPowerLimit(esp_power_level_t limit) {
+    txPowerLimit = limit < TX_POWER_MIN ? TX_POWER_MIN : (limit > TX_POWER_MAX ? TX_POWER_MAX : limit);
+    if (txPowerLevel > txPowerLimit) {
+        setTxPowerLevel(txPowerLimit);
+    }
+}
+
+// Sample link quality and step TX power with hysteresis
+void BLEJoystick::updateLinkQuality() {
+    uint32_t now = millis();
+    uint32_t elapsed = now - lastTxPowerSample;
+    if (elapsed < LINK_SAMPLE_INTERVAL) {
+        return;
+    }
+    lastTxPowerSample = now;
+    
+    if (deviceState != DEVICE_CONNECTED || peerCount == 0) {
+        return;
+    }
+    
+    // The weakest peer and the combined notify failure rate decide the level
+    int8_t weakestRssi = 127;
+    uint32_t sent = 0;
+    uint32_t failed = 0;
+    uint32_t airtime = 0;
+    lockPeers();
+    for (uint8_t i = 0; i < peerCount; i++) {
+        PeerLink& peer = peers[i];
+        if (ble_gap_conn_rssi(peer.connHandle, &peer.rssi) == 0) {
+            if (peer.rssiSamples == 0 || peer.rssi < peer.rssiMin) {
+                peer.rssiMin = peer.rssi;
+            }
+            if (peer.rssiSamples == 0 || peer.rssi > peer.rssiMax) {
+                peer.rssiMax = peer.rssi;
+            }
+            peer.rssiSum += peer.rssi;
+            peer.rssiSamples++;
+            if (peer.rssi < weakestRssi) {
+                weakestRssi = peer.rssi;
+            }
+        }
+        
+        uint32_t peerSent = peer.notifySent - peer.sampledSent;
+        sent += peerSent;
+        failed += peer.notifyFailed - peer.sampledFailed;
+        peer.sampledSent = peer.notifySent;
+        peer.sampledFailed = peer.notifyFailed;
+        
+        // Radio on-air time since the last sample, halved on 2M PHY
+        uint32_t eventPeriod = peer.connInterval * 1250 * (peer.connLatency + 1);
+        uint32_t events = eventPeriod > 0 ? (uint32_t)((uint64_t)elapsed * 1000 / eventPeriod) : 0;
+        uint32_t peerAirtime = events * EMPTY_PDU_AIRTIME + peerSent * REPORT_PDU_AIRTIME;
+        airtime += peer.txPhy == BLE_GAP_LE_PHY_2M ? peerAirtime / 2 : peerAirtime;
+    }
+    unlockPeers();
+    
+    // Charge saved against running at the default level
+    float currentSaved = txPowerCurrent[TX_POWER_MAX - TX_POWER_MIN] - txPowerCurrent[txPowerLevel - TX_POWER_MIN];
+    txEnergySaved += airtime / 1000000.0f * currentSaved * 1000.0f / 3600.0f;
+    
+    if (!autoTxPower) {
+        return;
+    }
+    
+    bool failing = failed * 100 > (sent + failed) * TX_POWER_FAIL_PERCENT;
+    if (weakestRssi < TX_POWER_RSSI_LOW || failing) {
+        // Link getting weak, step up right away
+        txPowerHold = 0;
+        if (txPowerLevel < txPowerLimit) {
+            setTxPowerLevel((esp_power_level_t)(txPowerLevel + 1));
+        }
+    } else if (weakestRssi > TX_POWER_RSSI_HIGH && failed == 0) {
+        // Link strong, step down only after it stayed strong for a while
+        if (++txPowerHold >= TX_POWER_HOLD_SAMPLES) {
+            txPowerHold = 0;
+            if (txPowerLevel > TX_POWER_MIN) {
+                setTxPowerLevel((esp_power_level_t)(txPowerLevel - 1));
+            }
+        }
+    } else {
+        txPowerHold = 0;
+    }
+}
+
+// Snapshot the statistics of a connection
+BLEJoystick::LinkStats BLEJoystick::makeLinkStats(const PeerLink& peer) const {
+    LinkStats stats;
+    stats.duration = millis() - peer.linkUpTime;
+    stats.notifySent = peer.notifySent;
+    stats.notifyFailed = peer.notifyFailed;
+    stats.mbufExhausted = peer.mbufExhausted;
+    stats.connUpdates = peer.connUpdates;
+    stats.rssiSamples = peer.rssiSamples;
+    stats.rssiMin = peer.rssiMin;
+    stats.rssiMax = peer.rssiMax;
+    stats.rssiAvg = peer.rssiSamples > 0 ? peer.rssiSum / peer.rssiSamples : 0;
+    stats.hostSlot = peer.hostSlot;
+    stats.disconnectReason = 0;
+    return stats;
+}
+
+// Keep the statistics of a closed connection
+void BLEJoystick::recordLinkHistory(const PeerLink& peer, uint16_t reason) {
+    linkHistoryHead = (linkHistoryHead + 1) % LINK_HISTORY_SIZE;
+    linkHistory[linkHistoryHead] = makeLinkStats(peer);
+    linkHistory[linkHistoryHead].disconnectReason = reason;
+    if (linkHistoryCount < LINK_HISTORY_SIZE) {
+        linkHistoryCount++;
+    }
+    
+    disconnectCount++;
+    if (reason == SUPERVISION_TIMEOUT_REASON) {
+        supervisionTimeouts++;
+    }
+}
+
+// Get the statistics of a live connection
+BLEJoystick::LinkStats BLEJoystick::getLinkStats(uint8_t peer) const {
+    if (peer >= peerCount) {
+        LinkStats stats;
+        memset(&stats, 0, sizeof(stats));
+        return stats;
+    }
+    return makeLinkStats(peers[peer]);
+}
+
+// Get number of closed connections kept
+uint8_t BLEJoystick::getLinkHistoryCount() const {
+    return linkHistoryCount;
+}
+
+// Get the statistics of a closed connection
+const BLEJoystick::LinkStats& BLEJoystick::getLinkHistory(uint8_t index) const {
+    if (index >= linkHistoryCount) {
+        index = 0;
+    }
+    return linkHistory[(linkHistoryHead + LINK_HISTORY_SIZE - index) % LINK_HISTORY_SIZE];
+}
+
+// Get number of connections since boot
+uint16_t BLEJoystick::getConnectCount() const {
+    return connectCount;
+}
+
+// Get number of connections lost to supervision timeout
+uint16_t BLEJoystick::getSupervisionTimeouts() const {
+    return supervisionTimeouts;
+}
+
+// Print link statistics in a human-readable format
+void BLEJoystick::printLinkStats() const {
+    Serial.println("=== LINK STATS ===");
+    Serial.printf("Connects: %u, disconnects: %u, supervision timeouts: %u, TX power: %d dBm\n",
+                  connectCount, disconnectCount, supervisionTimeouts, getTxPower());
+    Serial.printf("HID suspended: %lu s%s\n", (unsigned long)(getSuspendedTime() / 1000),
+                  suspended ? " (now)" : "");
+    
+    for (uint8_t i = 0; i < peerCount + linkHistoryCount; i++) {
+        bool live = i < peerCount;
+        LinkStats stats = live ? getLinkStats(i) : getLinkHistory(i - peerCount);
+        if (live) {
+            Serial.printf("  Live %u", i + 1);
+        } else {
+            Serial.printf("  Closed (reason 0x%03X)", stats.disconnectReason);
+        }
+        Serial.printf(": host %d, %lu s, notify %lu ok / %lu failed (%lu no mbuf), %u param updates, "
+                      "RSSI %d/%d/%d dBm min/avg/max over %u samples\n",
+                      stats.hostSlot == NO_HOST_SLOT ? 0 : stats.hostSlot + 1,
+                      (unsigned long)(stats.duration / 1000), (unsigned long)stats.notifySent,
+                      (unsigned long)stats.notifyFailed, (unsigned long)stats.mbufExhausted, stats.connUpdates,
+                      stats.rssiMin, stats.rssiAvg, stats.rssiMax, stats.rssiSamples);
+    }
+    Serial.println("==================");
+}
+
+// Get the number of notifications sent since boot
+uint32_t BLEJoystick::getNotifyCount() const {
+    return notifyCount;
+}
+
+// Time the next report from the pad read that saw the press, kept as the worst case first-press latency
+void BLEJoystick::markFirstPress(uint32_t edgeTime) {
+    firstPressEdge = edgeTime;
+    firstPressPending = true;
+}
+
+// Get the worst-case first-press latency
+uint16_t BLEJoystick::getFirstPressLatency() const {
+    return firstPressLatency;
+}
+
+// Set the value of the energy characteristic
+void BLEJoystick::setEnergyReport(const uint8_t* data, size_t length) {
+    pEnergyCharacteristic->setValue(data, length);
+}
+
+// Check if the radio is between bursts, for measurements sensitive to TX load
+bool BLEJoystick::isRadioQuiet() {
+    // Asked from the battery sampling task while the loop and the host task change the peers
+    lockPeers();
+    bool quiet = !directedAdvertising && millis() - lastNotifyTime >= RADIO_QUIET_TIME;
+    for (uint8_t i = 0; quiet && i < peerCount; i++) {
+        quiet = peers[i].queueCount == 0 && peers[i].txInFlight == 0;
+    }
+    unlockPeers();
+    return quiet;
+}
+
+// Fill the diagnostic characteristic with current statistics
+void BLEJoystick::updateDiagnostics() {
+    uint8_t value[sizeof(DiagnosticsHeader) + (MAX_PEERS + LINK_HISTORY_SIZE) * sizeof(LinkStats)];
+    
+    DiagnosticsHeader header;
+    header.version = DIAGNOSTICS_VERSION;
+    header.peerCount = peerCount;
+    header.historyCount = linkHistoryCount;
+    header.txPower = getTxPower();
+    header.connects = connectCount;
+    header.disconnects = disconnectCount;
+    header.supervisionTimeouts = supervisionTimeouts;
+    header.suspendedTime = getSuspendedTime();
+    header.firstPressLatency = firstPressLatency;
+    memcpy(value, &header, sizeof(header));
+    
+    size_t length = sizeof(header);
+    for (uint8_t i = 0; i < peerCount; i++) {
+        LinkStats stats = getLinkStats(i);
+        memcpy(value + length, &stats, sizeof(stats));
+        length += sizeof(stats);
+    }
+    for (uint8_t i = 0; i < linkHistoryCount; i++) {
+        memcpy(value + length, &getLinkHistory(i), sizeof(LinkStats));
+        length += sizeof(LinkStats);
+    }
+    
+    pDiagnosticsCharacteristic->setValue(value, length);
+}
+
+// Enter suspend once every host asked for it, leave it as soon as one didn't
+void BLEJoystick::updateSuspendState() {
+    bool allSuspended = peerCount > 0;
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (!peers[i].suspended) {
+            allSuspended = false;
+        }
+    }
+    
+    if (allSuspended && !suspended) {
+        suspended = true;
+        suspendStartTime = millis();
+        Serial.println("Host suspended HID, relaxing link");
+        requestIdleConnParams();
+    } else if (!allSuspended && suspended) {
+        suspended = false;
+        suspendedTime += millis() - suspendStartTime;
+        Serial.println("HID suspend ended");
+    }
+}
+
+// Check if every connected host suspended HID
+bool BLEJoystick::isSuspended() const {
+    return suspended;
+}
+
+// Get total time suspended, including an ongoing suspend
+uint32_t BLEJoystick::getSuspendedTime() const {
+    return suspended ? suspendedTime + (millis() - suspendStartTime) : suspendedTime;
+}
+
+// Get the current TX power
+int8_t BLEJoystick::getTxPower() const {
+    return 9 - 3 * (ESP_PWR_LVL_P9 - txPowerLevel);
+}
+
+// Get the last sampled RSSI of a peer
+int8_t BLEJoystick::getRssi(uint8_t peer) const {
+    return peer < peerCount ? peers[peer].rssi : 0;
+}
+
+// Get the estimated charge saved by running below TX_POWER_MAX
+float BLEJoystick::getTxEnergySaved() const {
+    return txEnergySaved;
+}
+
+// Apply a TX power level to connections and advertising
+void BLEJoystick::setTxPowerLevel(esp_power_level_t level) {
+    if (level > txPowerLimit) {
+        level = txPowerLimit;
+    }
+    if (level == txPowerLevel) {
+        return;
+    }
+    
+    txPowerLevel = level;
+    NimBLEDevice::setPower(level);
+    Serial.printf("TX power %d dBm (saved %.3f uAh so far)\n", getTxPower(), txEnergySaved);
+}
+
+// Request 2M PHY and data length extension on a connection
+void BLEJoystick::requestFastPhy(PeerLink& peer) {
+    // Start from what the link is using now
+    if (ble_gap_read_le_phy(peer.connHandle, &peer.txPhy, &peer.rxPhy) != 0) {
+        peer.txPhy = BLE_GAP_LE_PHY_1M;
+        peer.rxPhy = BLE_GAP_LE_PHY_1M;
+    }
+    
+    // Skip the request for hosts known to stay on 1M
+    bool knownSlowHost = peer.hostSlot != NO_HOST_SLOT && hostSlots[peer.hostSlot].phy == BLE_GAP_LE_PHY_1M;
+    
+    if (!knownSlowHost && (peer.txPhy != BLE_GAP_LE_PHY_2M || peer.rxPhy != BLE_GAP_LE_PHY_2M)) {
+        peer.phyStatus = ble_gap_set_prefered_le_phy(peer.connHandle, BLE_GAP_LE_PHY_2M_MASK,
+                                                     BLE_GAP_LE_PHY_2M_MASK, BLE_GAP_LE_PHY_CODED_ANY);
+        if (peer.phyStatus != 0) {
+            Serial.printf("2M PHY request failed (%d), staying on %s PHY\n", peer.phyStatus, phyName(peer.txPhy));
+        }
+    }
+    
+    pServer->setDataLen(peer.connHandle, MAX_DATA_LEN);
+}
+
+// GAP event handler
+int BLEJoystick::handleGapEvent(ble_gap_event* event, void*) {
+    BLEJoystick* device = instance;
+    if (device == nullptr) {
+        return 0;
+    }
+    
+    PeerLink* peer = nullptr;
+    
+    // A bonded host pairing again needs the key pair too
+    if (event->type == BLE_GAP_EVENT_REPEAT_PAIRING) {
+        device->waitForPairingKey();
+        return 0;
+    }
+    
+    // Runs on the NimBLE host task
+    device->lockPeers();
+    switch (event->type) {
+        case BLE_GAP_EVENT_CONN_UPDATE:
+            peer = device->findPeer(event->conn_update.conn_handle);
+            if (peer == nullptr) {
+                break;
+            }
+            peer->connParamsStatus = event->conn_update.status;
+            if (event->conn_update.status == 0) {
+                peer->connUpdates++;
+            }
+            device->refreshConnParams(*peer);
+            Serial.printf("Connection parameters %s: interval %.2f ms, latency %u, timeout %u ms\n",
+                          event->conn_update.status == 0 ? "updated" : "rejected",
+                          peer->connInterval * 1.25, peer->connLatency, peer->connTimeout * 10);
+            
+            // Cache the active interval this host accepts
+            if (event->conn_update.status == 0 && peer->connProfile == CONN_PROFILE_ACTIVE &&
+                peer->hostSlot != NO_HOST_SLOT &&
+                device->hostSlots[peer->hostSlot].connInterval != peer->connInterval) {
+                device->hostSlots[peer->hostSlot].connInterval = peer->connInterval;
+                device->hostSlotsDirty = true;
+            }
+            break;
+            
+        case BLE_GAP_EVENT_DISCONNECT:
+            // Keep the statistics with the reason while the peer is still tracked
+            peer = device->findPeer(event->disconnect.conn.conn_handle);
+            if (peer != nullptr) {
+                device->recordLinkHistory(*peer, event->disconnect.reason);
+                device->removePeer(event->disconnect.conn.conn_handle);
+                Serial.printf("Disconnected, reason 0x%03X\n", event->disconnect.reason);
+            }
+            break;
+            
+        case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE:
+            peer = device->findPeer(event->phy_updated.conn_handle);
+            if (peer == nullptr) {
+                break;
+            }
+            peer->phyStatus = event->phy_updated.status;
+            if (event->phy_updated.status == 0) {
+                peer->txPhy = event->phy_updated.tx_phy;
+                peer->rxPhy = event->phy_updated.rx_phy;
+            }
+            Serial.printf("PHY %s: TX %s, RX %s\n",
+                          event->phy_updated.status == 0 ? "updated" : "update failed",
+                          phyName(peer->txPhy), phyName(peer->rxPhy));
+            
+            // Cache the PHY this host accepts
+            if (peer->hostSlot != NO_HOST_SLOT && device->hostSlots[peer->hostSlot].phy != peer->txPhy) {
+                device->hostSlots[peer->hostSlot].phy = peer->txPhy;
+                device->hostSlotsDirty = true;
+            }
+            break;
+            
+        case BLE_GAP_EVENT_SUBSCRIBE:
+            // Only notify peers that enabled input reports. NimBLE keeps the CCCDs of bonded hosts and
+            // restores them right after encryption (reason RESTORE), so a returning host gets reports
+            // without writing its CCCD again.
+            peer = device->findPeer(event->subscribe.conn_handle);
+            if (peer != nullptr && event->subscribe.attr_handle == device->pInputCharacteristic->getHandle()) {
+                peer->subscribed = event->subscribe.cur_notify;
+                peer->queueCount = 0;
+                if (peer->subscribed) {
+                    device->queueReport(*peer);
+                }
+                if (peer->subscribed && peer->subscribeTime == 0) {
+                    peer->subscribeTime = max<uint32_t>(1, millis() - peer->linkUpTime);
+                }
+            }
+            break;
+            
+        case BLE_GAP_EVENT_NOTIFY_TX:
+            // An input report left the stack, the peer may take another buffer
+            peer = device->findPeer(event->notify_tx.conn_handle);
+            if (peer != nullptr && event->notify_tx.attr_handle == device->pInputCharacteristic->getHandle() &&
+                peer->txInFlight > 0) {
+                peer->txInFlight--;
+            }
+            break;
+            
+        case BLE_GAP_EVENT_ENC_CHANGE:
+            peer = device->findPeer(event->enc_change.conn_handle);
+            if (peer == nullptr || event->enc_change.status != 0) {
+                break;
+            }
+            peer->encryptTime = max<uint32_t>(1, millis() - peer->linkUpTime);
+            
+            // The identity address is known once encryption is restored
+            if (peer->hostSlot == NO_HOST_SLOT) {
+                ble_gap_conn_desc desc;
+                if (ble_gap_conn_find(peer->connHandle, &desc) == 0) {
+                    peer->hostSlot = device->findHostSlot(desc.peer_id_addr);
+                }
+            }
+            break;
+            
+        default:
+            break;
+    }
+    device->unlockPeers();
+    
+    return 0;
+}
+
 // Update device state and call callback if set
 void BLEJoystick::updateDeviceState(uint8_t newState) {
     if (deviceState != newState) {
@@ -300,9 +1630,130 @@ void BLEJoystick::updateDeviceState(uint8_t newState) {
 BLEJoystick::ServerCallbacks::ServerCallbacks(BLEJoystick* device) : device(device) {}
 
 void BLEJoystick::ServerCallbacks::onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {
+    // A new host will pair: the loop no longer starts the key pair, or this host waits for it
+    if (!NimBLEDevice::isBonded(NimBLEAddress(desc->peer_id_addr))) {
+        uint8_t expected = PAIRING_KEY_PENDING;
+        if (device->pairingKeyState.compare_exchange_strong(expected, PAIRING_KEY_SKIPPED)) {
+            Serial.println("New host connected first, pairing key pair will be generated on pairing");
+        }
+        device->waitForPairingKey();
+    }
+    
+    device->lockPeers();
+    PeerLink* peer = device->addPeer(desc);
+    if (peer == nullptr) {
+        device->unlockPeers();
+        pServer->disconnect(desc->conn_handle);
+        return;
+    }
+    
+    // Known host, use its cached preferences
+    if (peer->hostSlot != NO_HOST_SLOT && peer->hostSlot != device->activeHostSlot) {
+        device->activeHostSlot = peer->hostSlot;
+        device->hostSlotsDirty = true;
+    }
+    
+    // Time from advertising start to connection
+    device->lastConnectTime = millis() - device->advertisingStartTime;
+    device->lastConnectDirected = device->directedAdvertising;
+    device->lastConnectTier = device->getAdvertisingTier();
+    if (!device->directedAdvertising && device->advTier < device->advTierCount) {
+        device->endAdvertisingTier();
+        device->advTierStats[device->advTier].connects++;
+        device->advTierStats[device->advTier].connectTime += device->lastConnectTime;
+    }
+    device->advertising = false;
+    device->directedAdvertising = false;
+    device->connectCount++;
+    Serial.printf("Connected in %lu ms (%s advertising), %u of %u hosts\n", (unsigned long)device->lastConnectTime,
+                  device->lastConnectDirected ? "directed" : "general", device->peerCount, MAX_PEERS);
+    device->printAdvertisingStats();
+    Serial.printf("Host connection parameters: interval %.2f ms, latency %u, timeout %u ms\n",
+                  peer->connInterval * 1.25, peer->connLatency, peer->connTimeout * 10);
+    
     device->updateDeviceState(BLEJoystick::DEVICE_CONNECTED);
+    device->updateSuspendState();
+    device->requestFastPhy(*peer);
+    device->requestConnParams(*peer, CONN_PROFILE_ACTIVE);
+    device->unlockPeers();
+}
+
+void BLEJoystick::ServerCallbacks::onDisconnect(NimBLEServer*, ble_gap_conn_desc* desc) {
+    // Normally already recorded from the GAP event with its reason
+    device->lockPeers();
+    PeerLink* peer = device->findPeer(desc->conn_handle);
+    if (peer != nullptr) {
+        device->recordLinkHistory(*peer, 0);
+        device->removePeer(desc->conn_handle);
+    }
+    device->unlockPeers();
+    device->printLinkStats();
+    if (device->hostSlotsDirty) {
+        device->saveHostSlots();
+    }
+    
+    // A suspend can't outlive the hosts that asked for it
+    device->updateSuspendState();
+    
+    // Advertise at full power again once no host is left
+    if (device->peerCount == 0) {
+        device->txPowerHold = 0;
+        device->setTxPowerLevel(TX_POWER_MAX);
+    }
+    
+    // Only the last live connection falls back, a local disconnect or stop already moved on
+    if (device->peerCount == 0 && device->deviceState == BLEJoystick::DEVICE_CONNECTED) {
+        device->updateDeviceState(device->advertising ? BLEJoystick::DEVICE_ADVERTISING : BLEJoystick::DEVICE_IDLE);
+    }
 }
 
-void BLEJoystick::ServerCallbacks::onDisconnect(NimBLEServer* pServer) {
-    device->updateDeviceState(BLEJoystick::DEVICE_IDLE);
+void BLEJoystick::ServerCallbacks::onAuthenticationComplete(ble_gap_conn_desc* desc) {
+    // Remember bonded hosts for directed advertising
+    if (desc->sec_state.bonded) {
+        bool newHost = device->findHostSlot(desc->peer_id_addr) == NO_HOST_SLOT;
+        device->lockPeers();
+        uint8_t slot = device->assignHostSlot(desc->peer_id_addr);
+        PeerLink* peer = device->findPeer(desc->conn_handle);
+        if (peer != nullptr) {
+            peer->hostSlot = slot;
+            
+            // Pairing phase timing for first-time hosts
+            if (newHost) {
+                device->lastPairingTime = millis() - peer->linkUpTime;
+                Serial.printf("Paired in %lu ms after link-up (key pair %s)\n",
+                              (unsigned long)device->lastPairingTime,
+                              device->isPairingKeyReady() ? "precomputed" : "generated during pairing");
+            }
+        }
+        device->unlockPeers();
+    }
+}
+
+// HID Control Point callbacks implementation
+BLEJoystick::HidControlCallbacks::HidControlCallbacks(BLEJoystick* device) : device(device) {}
+
+void BLEJoystick::HidControlCallbacks::onWrite(NimBLECharacteristic* pCharacteristic, ble_gap_conn_desc* desc) {
+    NimBLEAttValue value = pCharacteristic->getValue();
+    if (value.size() < 1) {
+        return;
+    }
+    
+    device->lockPeers();
+    PeerLink* peer = device->findPeer(desc->conn_handle);
+    if (peer != nullptr && value[0] == HID_CONTROL_SUSPEND) {
+        peer->suspended = true;
+        device->updateSuspendState();
+    } else if (peer != nullptr && value[0] == HID_CONTROL_EXIT_SUSPEND) {
+        peer->suspended = false;
+        device->updateSuspendState();
+        device->requestConnParams(*peer, CONN_PROFILE_ACTIVE);
+    }
+    device->unlockPeers();
+}
+
+// Diagnostic characteristic callbacks implementation
+BLEJoystick::DiagnosticsCallbacks::DiagnosticsCallbacks(BLEJoystick* device) : device(device) {}
+
+void BLEJoystick::DiagnosticsCallbacks::onRead(NimBLECharacteristic*) {
+    device->updateDiagnostics();
 }
@@ -0,0 +1,304 @@
+// BatteryMonitor.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "BatteryMonitor.h"
+#include "Hal.h"
+#include "esp_adc_cal.h"
+
+// Resting Li-ion discharge curve, open circuit millivolts to percent
+struct CurvePoint {
+    uint16_t milliVolts;
+    uint8_t level;
+};
+
+static constexpr CurvePoint dischargeCurve[] = {
+    {3300, 0}, {3500, 3}, {3600, 7}, {3680, 15}, {3740, 25}, {3780, 35}, {3820, 45},
+    {3870, 55}, {3930, 65}, {4000, 75}, {4080, 85}, {4150, 93}, {4200, 100}
+};
+static constexpr uint8_t CURVE_POINTS = sizeof(dischargeCurve) / sizeof(dischargeCurve[0]);
+
+// Interpolate within the curve segment containing milliVolts
+static constexpr uint8_t curveLevel(uint16_t milliVolts, uint8_t i = 0) {
+    return milliVolts <= dischargeCurve[0].milliVolts ? 0
+         : i + 1 >= CURVE_POINTS ? 100
+         : milliVolts > dischargeCurve[i + 1].milliVolts ? curveLevel(milliVolts, i + 1)
+         : dischargeCurve[i].level +
+           (uint32_t)(milliVolts - dischargeCurve[i].milliVolts) * (dischargeCurve[i + 1].level - dischargeCurve[i].level) /
+           (dischargeCurve[i + 1].milliVolts - dischargeCurve[i].milliVolts);
+}
+
+// Check the curve rises in both voltage and level
+static constexpr bool curveIsMonotonic(uint8_t i = 1) {
+    return i >= CURVE_POINTS ||
+           (dischargeCurve[i].milliVolts > dischargeCurve[i - 1].milliVolts &&
+            dischargeCurve[i].level >= dischargeCurve[i - 1].level && curveIsMonotonic(i + 1));
+}
+
+static_assert(curveIsMonotonic(), "discharge curve must be sorted");
+static_assert(curveLevel(3000) == 0 && curveLevel(4200) == 100 && curveLevel(4300) == 100, "discharge curve must span 0-100%");
+static_assert(curveLevel(3710) == 20, "discharge curve interpolation");
+
+// Constructor
+BatteryMonitor::BatteryMonitor(uint8_t pin, float divider) : pin(pin), divider(divider) {
+    calibrated = false;
+    task = nullptr;
+    results = nullptr;
+    valid = false;
+    milliVolts = 0;
+    spread = 0;
+    loadMilliAmps = 0;
+    estimatedLevel = 0;
+    level = 0;
+    levelValid = false;
+    levelTime = 0;
+    chargePin = NO_PIN;
+    standbyPin = NO_PIN;
+    chargeState = CHARGE_UNKNOWN;
+    pendingChargeState = CHARGE_UNKNOWN;
+    pendingChargeTime = 0;
+}
+
+// Configure the ADC channel and start sampling in the background
+void BatteryMonitor::begin() {
+    analogReadResolution(12);
+    analogSetPinAttenuation(pin, ADC_11db);
+
+    // Hal::readMilliVolts() applies the per-chip two-point calibration burned into eFuse
+    calibrated = esp_adc_cal_check_efuse(ESP_ADC_CAL_VAL_EFUSE_TP) == ESP_OK;
+    Serial.printf("Battery ADC %s\n", calibrated ? "calibrated from eFuse" : "using default reference");
+
+    // The loop only ever collects finished measurements, a newer one replaces an uncollected one
+    results = xQueueCreate(1, sizeof(Measurement));
+    if (xTaskCreate(sampleTask, "battery", TASK_STACK_SIZE, this, tskIDLE_PRIORITY, &task) != pdPASS) {
+        Serial.println("Battery sampling task failed to start");
+        task = nullptr;
+    }
+}
+
+// Ask whether the radio is between bursts, from the sampling task
+void BatteryMonitor::setRadioQuietCallback(std::function<bool()> callback) {
+    radioQuietCallback = callback;
+}
+
+// Follow the charger and take over a measurement the task finished
+bool BatteryMonitor::update() {
+    readChargePins();
+
+    Measurement measurement;
+    if (results == nullptr || xQueueReceive(results, &measurement, 0) != pdTRUE) {
+        return false;
+    }
+    finishMeasurement(measurement);
+    return true;
+}
+
+// Measure right away, blocking for all samples
+uint16_t BatteryMonitor::measure() {
+    finishMeasurement(acquire(false));
+    return milliVolts;
+}
+
+// Check if a measurement has completed
+bool BatteryMonitor::isValid() const {
+    return valid;
+}
+
+// Get the battery voltage in millivolts
+uint16_t BatteryMonitor::getMilliVolts() const {
+    return milliVolts;
+}
+
+// Get the spread of the trimmed samples in millivolts
+uint16_t BatteryMonitor::getSpread() const {
+    return spread;
+}
+
+// Check if the ADC uses eFuse calibration
+bool BatteryMonitor::isCalibrated() const {
+    return calibrated;
+}
+
+// Set the average current drawn from the cell
+void BatteryMonitor::setLoadCurrent(uint16_t milliAmps) {
+    loadMilliAmps = milliAmps;
+}
+
+// Get the measured voltage corrected for the sag under load, or the lift under charge current
+uint16_t BatteryMonitor::getOpenCircuitMilliVolts() const {
+    if (chargeState == CHARGE_CHARGING) {
+        uint16_t lift = (uint32_t)CHARGE_CURRENT * CELL_RESISTANCE / 1000;
+        return milliVolts > lift ? milliVolts - lift : 0;
+    }
+    if (chargeState == CHARGE_FULL) {
+        return milliVolts;
+    }
+    return milliVolts + (uint32_t)loadMilliAmps * CELL_RESISTANCE / 1000;
+}
+
+// Get the state of charge of the last measurement
+uint8_t BatteryMonitor::getEstimatedLevel() const {
+    return estimatedLevel;
+}
+
+// Get the reported state of charge
+uint8_t BatteryMonitor::getLevel() const {
+    return level;
+}
+
+// Take over the reported level from before deep sleep, so hosts don't see it jump
+void BatteryMonitor::restoreLevel(uint8_t level) {
+    this->level = min<uint8_t>(level, 100);
+    levelValid = true;
+    levelTime = Hal::millis();
+}
+
+// Sense the charger's CHRG and STDBY outputs
+void BatteryMonitor::setChargePins(uint8_t chargePin, uint8_t standbyPin) {
+    this->chargePin = chargePin;
+    this->standbyPin = standbyPin;
+    if (chargePin != NO_PIN) {
+        Hal::pinInput(chargePin, true);
+    }
+    if (standbyPin != NO_PIN) {
+        Hal::pinInput(standbyPin, true);
+    }
+    readChargePins();
+}
+
+// Get the charger state
+uint8_t BatteryMonitor::getChargeState() const {
+    return chargeState;
+}
+
+// Check if the device runs from external power
+bool BatteryMonitor::isExternalPower() const {
+    return chargeState == CHARGE_CHARGING || chargeState == CHARGE_FULL;
+}
+
+// Follow the charger outputs, ignoring short flickers
+void BatteryMonitor::readChargePins() {
+    if (chargePin == NO_PIN) {
+        return;
+    }
+    
+    uint8_t state = CHARGE_DISCHARGING;
+    if (!Hal::readPin(chargePin)) {
+        state = CHARGE_CHARGING;
+    } else if (standbyPin != NO_PIN && !Hal::readPin(standbyPin)) {
+        state = CHARGE_FULL;
+    }
+    
+    uint32_t now = Hal::millis();
+    if (state != pendingChargeState) {
+        pendingChargeState = state;
+        pendingChargeTime = now;
+    }
+    if (state != chargeState && (chargeState == CHARGE_UNKNOWN || now - pendingChargeTime >= CHARGE_DEBOUNCE)) {
+        chargeState = state;
+    }
+}
+
+// Without charger outputs, take a clear voltage step between measurements as the charger coming or going
+void BatteryMonitor::inferChargeState(uint16_t previousMilliVolts) {
+    if (chargeState == CHARGE_UNKNOWN) {
+        chargeState = CHARGE_DISCHARGING;
+    }
+    if (previousMilliVolts == 0) {
+        return;
+    }
+    
+    if (chargeState == CHARGE_DISCHARGING && milliVolts >= previousMilliVolts + CHARGE_RISE) {
+        chargeState = CHARGE_CHARGING;
+    } else if (chargeState == CHARGE_CHARGING && milliVolts + CHARGE_RISE <= previousMilliVolts) {
+        chargeState = CHARGE_DISCHARGING;
+    }
+}
+
+// Read a round of calibrated samples, optionally spaced out between radio bursts, and average between the trimmed ends
+BatteryMonitor::Measurement BatteryMonitor::acquire(bool spaced) {
+    uint16_t samples[SAMPLE_COUNT];
+    for (uint8_t count = 0; count < SAMPLE_COUNT; count++) {
+        if (spaced) {
+            vTaskDelay(pdMS_TO_TICKS(SAMPLE_SPACING));
+            waitForQuietRadio();
+        }
+
+        // Kept sorted for trimming
+        uint16_t sample = Hal::readMilliVolts(pin);
+        uint8_t i = count;
+        while (i > 0 && samples[i - 1] > sample) {
+            samples[i] = samples[i - 1];
+            i--;
+        }
+        samples[i] = sample;
+    }
+
+    uint32_t sum = 0;
+    for (uint8_t i = SAMPLE_TRIM; i < SAMPLE_COUNT - SAMPLE_TRIM; i++) {
+        sum += samples[i];
+    }
+
+    Measurement measurement;
+    measurement.pinMilliVolts = (sum + (SAMPLE_COUNT - 2 * SAMPLE_TRIM) / 2) / (SAMPLE_COUNT - 2 * SAMPLE_TRIM);
+    measurement.spread = samples[SAMPLE_COUNT - SAMPLE_TRIM - 1] - samples[SAMPLE_TRIM];
+    return measurement;
+}
+
+// TX current sags the cell, wait for a gap but don't starve the measurement
+void BatteryMonitor::waitForQuietRadio() {
+    uint32_t waitStartTime = Hal::millis();
+    while (radioQuietCallback && !radioQuietCallback() && Hal::millis() - waitStartTime < RADIO_WAIT_LIMIT) {
+        vTaskDelay(1);
+    }
+}
+
+// Scale a measurement to battery voltage
+void BatteryMonitor::finishMeasurement(const Measurement& measurement) {
+    uint16_t previousMilliVolts = valid ? milliVolts : 0;
+    milliVolts = measurement.pinMilliVolts * divider + 0.5f;
+    spread = measurement.spread * divider + 0.5f;
+    valid = true;
+    if (chargePin == NO_PIN) {
+        inferChargeState(previousMilliVolts);
+    }
+    updateLevel();
+}
+
+// Estimate the state of charge and move the reported level past the hysteresis, at a limited rate
+void BatteryMonitor::updateLevel() {
+    estimatedLevel = curveLevel(getOpenCircuitMilliVolts());
+
+    // The curve only holds for a resting or discharging cell, so under charge the level may
+    // only rise, and 100% waits for the charger to terminate
+    if (chargeState == CHARGE_FULL) {
+        estimatedLevel = 100;
+    } else if (chargeState == CHARGE_CHARGING) {
+        estimatedLevel = min<uint8_t>(estimatedLevel, 99);
+        if (levelValid && estimatedLevel < level) {
+            estimatedLevel = level;
+        }
+    }
+
+    uint32_t now = Hal::millis();
+    if (levelValid) {
+        int delta = (int)estimatedLevel - level;
+        if (abs(delta) < LEVEL_HYSTERESIS || now - levelTime < LEVEL_HOLD_TIME) {
+            return;
+        }
+    }
+
+    level = estimatedLevel;
+    levelValid = true;
+    levelTime = now;
+}
+
+// Measure every MEASURE_INTERVAL, running only when the loop task is waiting
+void BatteryMonitor::sampleTask(void* arg) {
+    BatteryMonitor* monitor = static_cast<BatteryMonitor*>(arg);
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(MEASURE_INTERVAL));
+        Measurement measurement = monitor->acquire(true);
+        xQueueOverwrite(monitor->results, &measurement);
+    }
+}
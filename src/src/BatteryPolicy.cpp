@@ -0,0 +1,76 @@
+// BatteryPolicy.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "BatteryPolicy.h"
+
+static const char* stageNames[] = { "normal", "low", "critical", "shutdown" };
+
+// Constructor
+BatteryPolicy::BatteryPolicy() {
+    lowLevel = DEFAULT_LOW_LEVEL;
+    criticalLevel = DEFAULT_CRITICAL_LEVEL;
+    shutdownLevel = DEFAULT_SHUTDOWN_LEVEL;
+    shutdownMilliVolts = DEFAULT_SHUTDOWN_MILLIVOLTS;
+    stage = STAGE_NORMAL;
+    undervoltageCount = 0;
+}
+
+// Set the stage thresholds
+void BatteryPolicy::setThresholds(uint8_t low, uint8_t critical, uint8_t shutdown, uint16_t shutdownMilliVolts) {
+    lowLevel = low;
+    criticalLevel = critical;
+    shutdownLevel = shutdown;
+    this->shutdownMilliVolts = shutdownMilliVolts;
+}
+
+// Pick the stage for a new battery measurement
+bool BatteryPolicy::update(uint8_t level, uint16_t milliVolts, bool externalPower) {
+    uint8_t next;
+    if (externalPower) {
+        next = STAGE_NORMAL;
+        undervoltageCount = 0;
+    } else {
+        // Degrade as soon as a threshold is crossed, recover only with some margin
+        next = stageFor(level, 0);
+        if (next < stage) {
+            next = max(next, stageFor(level, STAGE_HYSTERESIS));
+        }
+
+        // The level lags a collapsing cell, so a sustained low voltage shuts down too
+        undervoltageCount = milliVolts < shutdownMilliVolts ? undervoltageCount + 1 : 0;
+        if (undervoltageCount >= SHUTDOWN_CONFIRM) {
+            next = STAGE_SHUTDOWN;
+        }
+    }
+
+    if (next == stage) {
+        return false;
+    }
+    stage = next;
+    return true;
+}
+
+// Get the current stage
+uint8_t BatteryPolicy::getStage() const {
+    return stage;
+}
+
+// Get the name of the current stage
+const char* BatteryPolicy::getStageName() const {
+    return stageNames[stage];
+}
+
+// Stage of a level, with thresholds raised by margin
+uint8_t BatteryPolicy::stageFor(uint8_t level, uint8_t margin) const {
+    if (level <= shutdownLevel + margin) {
+        return STAGE_SHUTDOWN;
+    }
+    if (level <= criticalLevel + margin) {
+        return STAGE_CRITICAL;
+    }
+    if (level <= lowLevel + margin) {
+        return STAGE_LOW;
+    }
+    return STAGE_NORMAL;
+}
@@ -0,0 +1,180 @@
+// EnergyMonitor.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "EnergyMonitor.h"
+
+static const char* stateNames[] = {
+    "stopped", "idle", "advertising", "connected active", "connected idle", "standby", "sleep"
+};
+
+// Default per-state current, microamps
+static const uint32_t defaultStateCurrent[] = {
+    20000,      // stopped: CPU running, radio off
+    20000,      // idle
+    24000,      // advertising, averaged over the schedule
+    30000,      // connected active: 7.5 ms connection interval
+    22000,      // connected idle: relaxed interval with peripheral latency
+    700,        // standby: light sleep plus the read every 50 ms
+    15          // deep sleep
+};
+
+// Constructor
+EnergyMonitor::EnergyMonitor() {
+    memcpy(stateCurrent, defaultStateCurrent, sizeof(stateCurrent));
+    capacity = DEFAULT_CAPACITY;
+    state = STATE_STOPPED;
+    stateStartTime = millis();
+    memset(stateTime, 0, sizeof(stateTime));
+    txCount = 0;
+    cpuBusyTime = 0;
+    lastTxCount = 0;
+    lastCpuBusyTime = 0;
+}
+
+// Set the average current of a state
+void EnergyMonitor::setStateCurrent(uint8_t state, uint32_t microAmps) {
+    if (state < STATE_COUNT) {
+        stateCurrent[state] = microAmps;
+    }
+}
+
+// Get the average current of a state
+uint32_t EnergyMonitor::getStateCurrent(uint8_t state) const {
+    return state < STATE_COUNT ? stateCurrent[state] : 0;
+}
+
+// Set the battery capacity
+void EnergyMonitor::setCapacity(uint16_t mAh) {
+    capacity = mAh;
+}
+
+// Switch power state, closing the time of the previous one
+void EnergyMonitor::setState(uint8_t state) {
+    if (state == this->state || state >= STATE_COUNT) {
+        return;
+    }
+
+    uint32_t now = millis();
+    stateTime[this->state] += now - stateStartTime;
+    stateStartTime = now;
+    this->state = state;
+}
+
+// Get the current power state
+uint8_t EnergyMonitor::getState() const {
+    return state;
+}
+
+// Add time spent in a state while the firmware wasn't running, like deep sleep
+void EnergyMonitor::addStateTime(uint8_t state, uint32_t milliseconds) {
+    if (state < STATE_COUNT) {
+        stateTime[state] += milliseconds;
+    }
+}
+
+// Take in the radio and CPU counters, which restart from zero after deep sleep
+void EnergyMonitor::update(uint32_t txCount, uint32_t cpuBusyTime) {
+    this->txCount += txCount - lastTxCount;
+    this->cpuBusyTime += cpuBusyTime - lastCpuBusyTime;
+    lastTxCount = txCount;
+    lastCpuBusyTime = cpuBusyTime;
+}
+
+// Continue from the totals before deep sleep
+void EnergyMonitor::restore(const RetainedState& state) {
+    memcpy(stateTime, state.stateTime, sizeof(stateTime));
+    txCount = state.txCount;
+    cpuBusyTime = state.cpuBusyTime;
+}
+
+// Save the totals before deep sleep
+void EnergyMonitor::retain(RetainedState& state) {
+    setState(STATE_SLEEP);
+    memcpy(state.stateTime, stateTime, sizeof(stateTime));
+    state.txCount = txCount;
+    state.cpuBusyTime = cpuBusyTime;
+}
+
+// Get the time spent in a state, including the ongoing one
+uint32_t EnergyMonitor::getStateTime(uint8_t state) const {
+    if (state >= STATE_COUNT) {
+        return 0;
+    }
+    return state == this->state ? stateTime[state] + (millis() - stateStartTime) : stateTime[state];
+}
+
+// Get the estimated charge used since power-up
+uint32_t EnergyMonitor::getConsumed() const {
+    return getCharge() / 3600000;
+}
+
+// Get the average current since power-up
+uint32_t EnergyMonitor::getAverageCurrent() const {
+    uint32_t total = getTotalTime();
+    return total > 0 ? getCharge() / total : 0;
+}
+
+// Get the runtime left at the average current
+uint32_t EnergyMonitor::getRemainingTime(uint8_t batteryLevel) const {
+    uint32_t current = getAverageCurrent();
+    if (current == 0) {
+        return 0;
+    }
+    uint64_t remaining = (uint64_t)capacity * 1000 * min<uint8_t>(batteryLevel, 100) / 100;   // microamp-hours
+    return remaining * 60 / current;
+}
+
+// Build the energy characteristic value
+EnergyMonitor::EnergyReport EnergyMonitor::getReport(uint8_t batteryLevel) const {
+    EnergyReport report;
+    memset(&report, 0, sizeof(report));
+    report.version = REPORT_VERSION;
+    report.state = state;
+    report.batteryLevel = batteryLevel;
+    for (uint8_t i = 0; i < STATE_COUNT; i++) {
+        report.stateTime[i] = getStateTime(i) / 1000;
+    }
+    report.txCount = txCount;
+    report.cpuBusyTime = cpuBusyTime / 1000;
+    report.consumed = getConsumed();
+    report.averageCurrent = getAverageCurrent();
+    report.remainingTime = getRemainingTime(batteryLevel);
+    return report;
+}
+
+// Print energy statistics
+void EnergyMonitor::printStats(uint8_t batteryLevel) const {
+    Serial.println("=== ENERGY ===");
+    for (uint8_t i = 0; i < STATE_COUNT; i++) {
+        Serial.printf("  %-16s %8lu s at %5lu uA%s\n", stateNames[i], (unsigned long)(getStateTime(i) / 1000),
+                      (unsigned long)stateCurrent[i], i == state ? " (now)" : "");
+    }
+    uint32_t remaining = getRemainingTime(batteryLevel);
+    Serial.printf("TX %lu notifications, CPU busy %lu ms\n", (unsigned long)txCount,
+                  (unsigned long)(cpuBusyTime / 1000));
+    Serial.printf("Used %lu uAh, average %lu uA, %u%% of %u mAh left, ~%luh%02lum remaining\n",
+                  (unsigned long)getConsumed(), (unsigned long)getAverageCurrent(), batteryLevel, capacity,
+                  (unsigned long)(remaining / 60), (unsigned long)(remaining % 60));
+    Serial.println("==============");
+}
+
+// Charge from state times, notifications and CPU busy time, microamp-milliseconds
+uint64_t EnergyMonitor::getCharge() const {
+    uint64_t charge = 0;
+    for (uint8_t i = 0; i < STATE_COUNT; i++) {
+        charge += (uint64_t)getStateTime(i) * stateCurrent[i];
+    }
+    charge += (uint64_t)txCount * NOTIFY_CHARGE * 1000;
+    charge += cpuBusyTime * CPU_BUSY_CURRENT / 1000;
+    return charge;
+}
+
+// Get the time accounted in all states
+uint32_t EnergyMonitor::getTotalTime() const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < STATE_COUNT; i++) {
+        total += getStateTime(i);
+    }
+    return total;
+}
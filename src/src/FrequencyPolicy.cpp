@@ -0,0 +1,135 @@
+// FrequencyPolicy.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "FrequencyPolicy.h"
+
+static const char* profileNames[] = { "idle", "advertising", "connected idle", "play" };
+
+// Constructor
+FrequencyPolicy::FrequencyPolicy() {
+    profile = PROFILE_IDLE;
+    profileStartTime = 0;
+    workStartTime = 0;
+    dynamic = false;
+    memset(stats, 0, sizeof(stats));
+#ifdef CONFIG_PM_ENABLE
+    workLock = nullptr;
+#endif
+}
+
+// Let esp_pm scale the clock where available, otherwise pick a fixed clock per profile
+void FrequencyPolicy::begin() {
+#ifdef CONFIG_PM_ENABLE
+    // The BLE controller holds its own PM locks while the radio works,
+    // the input/report path takes workLock, everything else idles at MIN_FREQ
+    esp_pm_config_esp32c3_t config = {};
+    config.max_freq_mhz = MAX_FREQ;
+    config.min_freq_mhz = MIN_FREQ;
+    config.light_sleep_enable = false;
+    if (esp_pm_configure(&config) == ESP_OK &&
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "input", &workLock) == ESP_OK) {
+        dynamic = true;
+    }
+#endif
+    profileStartTime = millis();
+    if (!dynamic) {
+        setCpuFrequencyMhz(profileFrequency(profile));
+    }
+    Serial.printf("CPU frequency %s, %lu-%lu MHz\n", dynamic ? "scaled by esp_pm" : "fixed per state",
+                  (unsigned long)MIN_FREQ, (unsigned long)MAX_FREQ);
+}
+
+// Switch to the profile of the current firmware state
+void FrequencyPolicy::setProfile(uint8_t profile) {
+    if (profile == this->profile || profile >= PROFILE_COUNT) {
+        return;
+    }
+
+    uint32_t now = millis();
+    stats[this->profile].time += now - profileStartTime;
+    profileStartTime = now;
+    this->profile = profile;
+
+    uint32_t frequency = profileFrequency(profile);
+    if (!dynamic && getCpuFrequencyMhz() != frequency) {
+        setCpuFrequencyMhz(frequency);
+    }
+}
+
+// Get the current profile
+uint8_t FrequencyPolicy::getProfile() const {
+    return profile;
+}
+
+// Check if esp_pm scales the clock
+bool FrequencyPolicy::isDynamic() const {
+    return dynamic;
+}
+
+// Enter the input/report path
+void FrequencyPolicy::beginWork() {
+#ifdef CONFIG_PM_ENABLE
+    if (dynamic) {
+        esp_pm_lock_acquire(workLock);
+    }
+#endif
+    workStartTime = micros();
+}
+
+// Leave the input/report path
+void FrequencyPolicy::endWork() {
+    uint32_t busy = micros() - workStartTime;
+#ifdef CONFIG_PM_ENABLE
+    if (dynamic) {
+        esp_pm_lock_release(workLock);
+    }
+#endif
+
+    ProfileStats& current = stats[profile];
+    current.work++;
+    current.busyTime += busy;
+    if (busy > current.maxBusyTime) {
+        current.maxBusyTime = busy;
+    }
+}
+
+// Get profiling statistics of a profile
+const FrequencyPolicy::ProfileStats& FrequencyPolicy::getProfileStats(uint8_t profile) const {
+    return stats[profile < PROFILE_COUNT ? profile : PROFILE_IDLE];
+}
+
+// Get the summed busy time of all profiles
+uint32_t FrequencyPolicy::getBusyTime() const {
+    uint32_t busy = 0;
+    for (uint8_t i = 0; i < PROFILE_COUNT; i++) {
+        busy += stats[i].busyTime;
+    }
+    return busy;
+}
+
+// Print profiling statistics
+void FrequencyPolicy::printStats() const {
+    Serial.println("=== CPU PROFILES ===");
+    for (uint8_t i = 0; i < PROFILE_COUNT; i++) {
+        ProfileStats current = stats[i];
+        if (i == profile) {
+            current.time += millis() - profileStartTime;
+        }
+        
+        // Busy microseconds over profile milliseconds, in hundredths of a percent
+        uint32_t load = current.time > 0 ? (uint64_t)current.busyTime * 10 / current.time : 0;
+        Serial.printf("  %-15s %3lu MHz, %lu s, %lu passes, %lu us avg / %lu us max busy, %lu.%02lu%% load\n",
+                      profileNames[i], (unsigned long)profileFrequency(i), (unsigned long)(current.time / 1000),
+                      (unsigned long)current.work,
+                      (unsigned long)(current.work > 0 ? current.busyTime / current.work : 0),
+                      (unsigned long)current.maxBusyTime, (unsigned long)(load / 100), (unsigned long)(load % 100));
+    }
+    Serial.println("====================");
+}
+
+// Clock a profile runs at outside the input/report path
+uint32_t FrequencyPolicy::profileFrequency(uint8_t profile) const {
+    // With esp_pm only the locks raise the clock, without it play keeps the full clock throughout
+    return profile == PROFILE_PLAY && !dynamic ? MAX_FREQ : MIN_FREQ;
+}
@@ -0,0 +1,89 @@
+// HalEsp32.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifdef ARDUINO
+
+#include "Hal.h"
+#include <Arduino.h>
+#include "esp_sleep.h"
+
+static uint8_t powerKeyPin = 0xFF;
+
+// Configure a pin as output
+void Hal::pinOutput(uint8_t pin) {
+    pinMode(pin, OUTPUT);
+}
+
+// Configure a pin as input
+void Hal::pinInput(uint8_t pin, bool pullup) {
+    pinMode(pin, pullup ? INPUT_PULLUP : INPUT);
+}
+
+// Drive an output pin
+void Hal::writePin(uint8_t pin, bool high) {
+    digitalWrite(pin, high ? HIGH : LOW);
+}
+
+// Read an input pin
+bool Hal::readPin(uint8_t pin) {
+    return digitalRead(pin) == HIGH;
+}
+
+// Get milliseconds since boot
+uint32_t Hal::millis() {
+    return ::millis();
+}
+
+// Get microseconds since boot
+uint32_t Hal::micros() {
+    return ::micros();
+}
+
+// Wait, letting other tasks run
+void Hal::delay(uint32_t milliseconds) {
+    ::delay(milliseconds);
+}
+
+// Busy wait for a short pulse
+void Hal::delayMicros(uint32_t microseconds) {
+    delayMicroseconds(microseconds);
+}
+
+// Read a pin voltage with the eFuse calibration applied
+uint16_t Hal::readMilliVolts(uint8_t pin) {
+    return analogReadMilliVolts(pin);
+}
+
+// Light sleep for a while, keeping RAM and the BLE stack
+bool Hal::lightSleep(uint32_t milliseconds) {
+    esp_sleep_enable_timer_wakeup((uint64_t)milliseconds * 1000);
+    esp_err_t err = esp_light_sleep_start();
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+    return err == ESP_OK;
+}
+
+// Enter deep sleep
+void Hal::deepSleep() {
+    esp_deep_sleep_start();
+}
+
+// Set the pin wired to the power key
+void Hal::setPowerKeyPin(uint8_t pin) {
+    powerKeyPin = pin;
+    pinMode(pin, OUTPUT);
+}
+
+// Hold the power key down for a while, then let go
+void Hal::pressPowerKey(uint32_t milliseconds) {
+    digitalWrite(powerKeyPin, LOW);
+    ::delay(milliseconds);
+    digitalWrite(powerKeyPin, HIGH);
+}
+
+// Let go of the power key
+void Hal::releasePowerKey() {
+    digitalWrite(powerKeyPin, HIGH);
+}
+
+#endif // ARDUINO
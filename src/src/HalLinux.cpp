@@ -0,0 +1,137 @@
+// HalLinux.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#ifndef ARDUINO
+
+#include "Hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const uint8_t PIN_COUNT = 32;
+
+// Simulated board
+static bool pinLevels[PIN_COUNT];
+static uint16_t pinMilliVolts[PIN_COUNT];
+static uint8_t powerKeyPin = 0xFF;
+static std::function<void(uint8_t, bool)> outputHook;
+static std::function<bool(uint8_t)> inputHook;
+
+// Read the monotonic clock in microseconds
+static uint64_t monotonicMicros() {
+    static uint64_t start = 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t micros = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    if (start == 0) {
+        start = micros;
+    }
+    return micros - start;
+}
+
+// Outputs need no setup in simulation
+void Hal::pinOutput(uint8_t) {
+}
+
+// Configure a pin as input, an unconnected pull-up reads high
+void Hal::pinInput(uint8_t pin, bool pullup) {
+    if (pin < PIN_COUNT) {
+        pinLevels[pin] = pullup;
+    }
+}
+
+// Drive an output pin
+void Hal::writePin(uint8_t pin, bool high) {
+    if (pin < PIN_COUNT) {
+        pinLevels[pin] = high;
+    }
+    if (outputHook) {
+        outputHook(pin, high);
+    }
+}
+
+// Read an input pin
+bool Hal::readPin(uint8_t pin) {
+    if (inputHook) {
+        return inputHook(pin);
+    }
+    return pin < PIN_COUNT && pinLevels[pin];
+}
+
+// Get milliseconds since start
+uint32_t Hal::millis() {
+    return monotonicMicros() / 1000;
+}
+
+// Get microseconds since start
+uint32_t Hal::micros() {
+    return monotonicMicros();
+}
+
+// Wait
+void Hal::delay(uint32_t milliseconds) {
+    struct timespec duration = { (time_t)(milliseconds / 1000), (long)(milliseconds % 1000) * 1000000 };
+    nanosleep(&duration, nullptr);
+}
+
+// Busy wait like the target does, sleeping would overshoot short pulses
+void Hal::delayMicros(uint32_t microseconds) {
+    uint64_t end = monotonicMicros() + microseconds;
+    while (monotonicMicros() < end) {
+    }
+}
+
+// Read the simulated pin voltage
+uint16_t Hal::readMilliVolts(uint8_t pin) {
+    return pin < PIN_COUNT ? pinMilliVolts[pin] : 0;
+}
+
+// Sleep as a plain wait, there is no radio to keep up
+bool Hal::lightSleep(uint32_t milliseconds) {
+    delay(milliseconds);
+    return true;
+}
+
+// End the program in place of deep sleep
+void Hal::deepSleep() {
+    printf("Deep sleep, exiting\n");
+    fflush(stdout);
+    exit(0);
+}
+
+// Set the pin wired to the power key
+void Hal::setPowerKeyPin(uint8_t pin) {
+    powerKeyPin = pin;
+}
+
+// Press the simulated power key
+void Hal::pressPowerKey(uint32_t milliseconds) {
+    writePin(powerKeyPin, false);
+    delay(milliseconds);
+    writePin(powerKeyPin, true);
+}
+
+// Let go of the simulated power key
+void Hal::releasePowerKey() {
+    writePin(powerKeyPin, true);
+}
+
+// Observe output pin changes
+void Hal::setOutputHook(std::function<void(uint8_t pin, bool high)> hook) {
+    outputHook = hook;
+}
+
+// Supply input pin levels
+void Hal::setInputHook(std::function<bool(uint8_t pin)> hook) {
+    inputHook = hook;
+}
+
+// Set the voltage an ADC pin reads
+void Hal::setMilliVolts(uint8_t pin, uint16_t milliVolts) {
+    if (pin < PIN_COUNT) {
+        pinMilliVolts[pin] = milliVolts;
+    }
+}
+
+#endif // ARDUINO
@@ -0,0 +1,178 @@
+// LedDriver.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "LedDriver.h"
+#include "esp_sleep.h"
+
+static const ledc_mode_t LED_MODE = LEDC_LOW_SPEED_MODE;
+static const ledc_timer_t LED_TIMER = LEDC_TIMER_0;
+static const ledc_channel_t LED_CHANNEL = LEDC_CHANNEL_0;
+
+// Constructor
+LedDriver::LedDriver(uint8_t pin, bool activeLow) : pin(pin), activeLow(activeLow) {
+    pattern = PATTERN_OFF;
+    parameter1 = 0;
+    parameter2 = 0;
+    timer = nullptr;
+    breathing = false;
+    fading = false;
+    breatheRising = false;
+}
+
+// Set up the LEDC timer and channel, starting dark
+void LedDriver::begin() {
+    // Clock LEDC from the fast RC oscillator and keep it powered in light sleep
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_ON);
+    configureTimer(PWM_FREQUENCY, PWM_RESOLUTION);
+
+    ledc_channel_config_t channel = {};
+    channel.gpio_num = pin;
+    channel.speed_mode = LED_MODE;
+    channel.channel = LED_CHANNEL;
+    channel.intr_type = LEDC_INTR_DISABLE;
+    channel.timer_sel = LED_TIMER;
+    channel.duty = 0;
+    channel.hpoint = 0;
+    channel.flags.output_invert = activeLow;
+    ledc_channel_config(&channel);
+    ledc_fade_func_install(0);
+
+    ledc_cbs_t callbacks = {};
+    callbacks.fade_cb = onFadeEnd;
+    ledc_cb_register(LED_MODE, LED_CHANNEL, &callbacks, this);
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = onTimer;
+    timerArgs.arg = this;
+    timerArgs.name = "led";
+    esp_timer_create(&timerArgs, &timer);
+}
+
+// Turn the light off before deep sleep, where nothing needs the RC clock
+void LedDriver::end() {
+    off();
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_AUTO);
+}
+
+// Turn the light off
+void LedDriver::off() {
+    setPattern(PATTERN_OFF, 0, 0);
+}
+
+// Light steadily at a brightness
+void LedDriver::on(uint8_t brightness) {
+    setPattern(PATTERN_ON, brightness, 0);
+}
+
+// Blink with the LEDC timer itself running at the blink rate
+void LedDriver::blink(uint8_t frequency, uint8_t dutyPercent) {
+    setPattern(PATTERN_BLINK, frequency < MIN_BLINK_FREQUENCY ? MIN_BLINK_FREQUENCY : frequency, min<uint8_t>(dutyPercent, 100));
+}
+
+// Fade up and down in hardware, the end of each fade turns it around
+void LedDriver::breathe(uint16_t period, uint8_t brightness) {
+    setPattern(PATTERN_BREATHE, period, brightness);
+}
+
+// Get the current pattern
+uint8_t LedDriver::getPattern() const {
+    return pattern;
+}
+
+// Switch to a new pattern, false if it is already running
+bool LedDriver::setPattern(uint8_t pattern, uint16_t parameter1, uint16_t parameter2) {
+    if (pattern == this->pattern && parameter1 == this->parameter1 && parameter2 == this->parameter2) {
+        return false;
+    }
+
+    esp_timer_stop(timer);
+    breathing = false;
+    this->pattern = pattern;
+    this->parameter1 = parameter1;
+    this->parameter2 = parameter2;
+
+    // The fade driver blocks duty changes until a fade ends, the end applies the new pattern instead
+    if (!fading) {
+        apply();
+    }
+    return true;
+}
+
+// Program the hardware for the current pattern
+void LedDriver::apply() {
+    switch (pattern) {
+        case PATTERN_ON:
+            configureTimer(PWM_FREQUENCY, PWM_RESOLUTION);
+            setDuty(scaleDuty(parameter1, PWM_RESOLUTION));
+            break;
+
+        case PATTERN_BLINK:
+            configureTimer(parameter1, BLINK_RESOLUTION);
+            setDuty(((uint32_t)1 << BLINK_RESOLUTION) * parameter2 / 100);
+            break;
+
+        case PATTERN_BREATHE:
+            configureTimer(PWM_FREQUENCY, PWM_RESOLUTION);
+            setDuty(0);
+            breathing = true;
+            breatheRising = false;
+            reverseFade();
+            break;
+
+        default:
+            setDuty(0);
+            break;
+    }
+}
+
+// Start the next half of a breath
+void LedDriver::reverseFade() {
+    uint16_t halfPeriod = parameter1 / 2;
+    breatheRising = !breatheRising;
+    fading = true;
+    ledc_set_fade_with_time(LED_MODE, LED_CHANNEL, breatheRising ? scaleDuty(parameter2, PWM_RESOLUTION) : 0, halfPeriod);
+    ledc_fade_start(LED_MODE, LED_CHANNEL, LEDC_FADE_NO_WAIT);
+}
+
+// Set the LEDC timer rate and resolution
+void LedDriver::configureTimer(uint32_t frequency, ledc_timer_bit_t resolution) {
+    ledc_timer_config_t config = {};
+    config.speed_mode = LED_MODE;
+    config.duty_resolution = resolution;
+    config.timer_num = LED_TIMER;
+    config.freq_hz = frequency;
+    config.clk_cfg = LEDC_USE_RTC8M_CLK;
+    ledc_timer_config(&config);
+}
+
+// Set the channel duty
+void LedDriver::setDuty(uint32_t duty) {
+    ledc_set_duty(LED_MODE, LED_CHANNEL, duty);
+    ledc_update_duty(LED_MODE, LED_CHANNEL);
+}
+
+// Convert a 0-255 brightness to a duty at a resolution
+uint32_t LedDriver::scaleDuty(uint8_t brightness, ledc_timer_bit_t resolution) {
+    return ((uint32_t)1 << resolution) * brightness / 255;
+}
+
+// A fade ended in hardware, the fade driver takes a mutex so the next step runs on the timer task
+bool IRAM_ATTR LedDriver::onFadeEnd(const ledc_cb_param_t* param, void* arg) {
+    LedDriver* led = static_cast<LedDriver*>(arg);
+    if (param->event == LEDC_FADE_END_EVT) {
+        led->fading = false;
+        esp_timer_start_once(led->timer, 0);
+    }
+    return false;
+}
+
+// Turn the breath around, or apply a pattern that waited for the last fade
+void LedDriver::onTimer(void* arg) {
+    LedDriver* led = static_cast<LedDriver*>(arg);
+    if (led->breathing) {
+        led->reverseFade();
+    } else {
+        led->apply();
+    }
+}
@@ -0,0 +1,189 @@
+// NesController.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "NesController.h"
+
+// Constructor
+NesController::NesController(uint8_t clockPin, uint8_t latchPin, uint8_t dataPin)
+    : clockPin(clockPin), latchPin(latchPin), dataPin(dataPin) {
+    buttons = 0;
+    chordButtons = 0;
+    startPressTime = 0;
+    selectPressTime = 0;
+    nextHostPressTime = 0;
+    addHostPressTime = 0;
+    nextHostChordHeld = false;
+    addHostChordHeld = false;
+}
+
+// Configure the shift register lines
+void NesController::begin() {
+    Hal::pinOutput(clockPin);
+    Hal::pinOutput(latchPin);
+    Hal::pinInput(dataPin, true);
+}
+
+// Shift in all buttons
+bool NesController::read() {
+    // Latch current button states
+    Hal::writePin(latchPin, true);
+    Hal::delayMicros(LATCH_PULSE);
+    Hal::writePin(latchPin, false);
+
+    uint8_t state = 0;
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        // NES buttons are active low
+        if (!Hal::readPin(dataPin)) {
+            state |= 1 << i;
+        }
+
+        // Clock pulse
+        Hal::writePin(clockPin, true);
+        Hal::delayMicros(CLOCK_HALF_PERIOD);
+        Hal::writePin(clockPin, false);
+        Hal::delayMicros(CLOCK_HALF_PERIOD);
+    }
+
+    // A chord stays out of the report from the moment it forms until each of its buttons is released,
+    // so switching or adding hosts doesn't press A or B in the game on the way
+    uint8_t chords[] = { 1 << BUTTON_SELECT | 1 << BUTTON_A, 1 << BUTTON_SELECT | 1 << BUTTON_B };
+    for (uint8_t chord : chords) {
+        if ((state & chord) == chord) {
+            chordButtons |= chord;
+        }
+    }
+    chordButtons &= state;
+
+    bool changed = state != buttons;
+    buttons = state;
+    return changed;
+}
+
+// Check if a button is pressed
+bool NesController::isPressed(uint8_t button) const {
+    return (buttons >> button) & 1;
+}
+
+// Check if a button is pressed and goes into the report
+bool NesController::isReported(uint8_t button) const {
+    return ((buttons & ~chordButtons) >> button) & 1;
+}
+
+// Check if any button is pressed
+bool NesController::isAnyPressed() const {
+    return buttons != 0;
+}
+
+// Get all buttons
+uint8_t NesController::getButtons() const {
+    return buttons;
+}
+
+// Get the hat direction of the D-pad
+uint8_t NesController::getHat() const {
+    bool up = isPressed(BUTTON_UP);
+    bool down = isPressed(BUTTON_DOWN);
+    bool left = isPressed(BUTTON_LEFT);
+    bool right = isPressed(BUTTON_RIGHT);
+
+    if (up && right) {
+        return 2;
+    } else if (right && down) {
+        return 4;
+    } else if (down && left) {
+        return 6;
+    } else if (left && up) {
+        return 8;
+    } else if (up) {
+        return 1;
+    } else if (right) {
+        return 3;
+    } else if (down) {
+        return 5;
+    } else if (left) {
+        return 7;
+    }
+    return 0;
+}
+
+// Get the X axis from the D-pad
+int8_t NesController::getX() const {
+    return isPressed(BUTTON_RIGHT) ? 127 : (isPressed(BUTTON_LEFT) ? -127 : 0);
+}
+
+// Get the Y axis from the D-pad
+int8_t NesController::getY() const {
+    return isPressed(BUTTON_DOWN) ? 127 : (isPressed(BUTTON_UP) ? -127 : 0);
+}
+
+// Time the hold gestures and detect the chords
+uint8_t NesController::updateGestures(uint32_t now) {
+    uint8_t events = 0;
+
+    // START long press
+    if (isPressed(BUTTON_START)) {
+        if (startPressTime == 0) {
+            startPressTime = now;
+        } else if (now - startPressTime >= POWER_OFF_HOLD_TIME) {
+            events |= EVENT_POWER_OFF;
+        }
+    } else {
+        startPressTime = 0;
+    }
+
+    // SELECT + A held, once per chord press
+    if (isPressed(BUTTON_SELECT) && isPressed(BUTTON_A)) {
+        if (nextHostPressTime == 0) {
+            nextHostPressTime = now;
+        } else if (!nextHostChordHeld && now - nextHostPressTime >= CHORD_HOLD_TIME) {
+            nextHostChordHeld = true;
+            events |= EVENT_NEXT_HOST;
+        }
+    } else {
+        nextHostPressTime = 0;
+        nextHostChordHeld = false;
+    }
+
+    // SELECT + B held, once per chord press
+    if (isPressed(BUTTON_SELECT) && isPressed(BUTTON_B)) {
+        if (addHostPressTime == 0) {
+            addHostPressTime = now;
+        } else if (!addHostChordHeld && now - addHostPressTime >= CHORD_HOLD_TIME) {
+            addHostChordHeld = true;
+            events |= EVENT_ADD_HOST;
+        }
+    } else {
+        addHostPressTime = 0;
+        addHostChordHeld = false;
+    }
+
+    // SELECT long press, once when the threshold is reached, not timed once part of a chord
+    if (isPressed(BUTTON_SELECT) && !((chordButtons >> BUTTON_SELECT) & 1)) {
+        if (selectPressTime == 0) {
+            selectPressTime = now;
+        } else if (now - selectPressTime >= RECONNECT_HOLD_TIME) {
+            selectPressTime = 0;
+            events |= EVENT_RECONNECT;
+        }
+    } else {
+        selectPressTime = 0;
+    }
+
+    return events;
+}
+
+// Check if a SELECT hold is being timed
+bool NesController::isSelectHeld() const {
+    return selectPressTime != 0;
+}
+
+// Forget held buttons, a press only counts as a gesture from its next update on
+void NesController::resetGestures() {
+    startPressTime = 0;
+    selectPressTime = 0;
+    nextHostPressTime = 0;
+    addHostPressTime = 0;
+    nextHostChordHeld = false;
+    addHostChordHeld = false;
+}
@@ -0,0 +1,164 @@
+// SleepManager.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+
+#include "SleepManager.h"
+#include "Hal.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include <sys/time.h>
+
+// Survives deep sleep, cleared by a power cycle
+RTC_DATA_ATTR static SleepManager::RetainedState retainedState;
+
+// Constructor
+SleepManager::SleepManager(uint8_t latchPin, uint8_t dataPin) : latchPin(latchPin), dataPin(dataPin) {
+    timerWake = 0;
+    wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+    wake = false;
+    sleepDuration = 0;
+    standbyStartTime = 0;
+    standbyTime = 0;
+    standbySleepTime = 0;
+    standbyWakes = 0;
+}
+
+// Find out why we booted and take back the pins held through sleep
+void SleepManager::begin() {
+    gpio_hold_dis((gpio_num_t)latchPin);
+    gpio_hold_dis((gpio_num_t)dataPin);
+    gpio_deep_sleep_hold_dis();
+
+    wakeCause = esp_sleep_get_wakeup_cause();
+    wake = (wakeCause == ESP_SLEEP_WAKEUP_GPIO || wakeCause == ESP_SLEEP_WAKEUP_TIMER) &&
+           retainedState.magic == RETAINED_MAGIC;
+    if (!wake) {
+        memset(&retainedState, 0, sizeof(retainedState));
+        return;
+    }
+
+    // RTC memory also survives a reset, only trust it once
+    retainedState.magic = 0;
+    sleepDuration = (rtcTime() - retainedState.sleepStartTime) / 1000;
+    Serial.printf("Woke from deep sleep %u (%s) after %lu s\n", retainedState.sleepCount,
+                  wakeCause == ESP_SLEEP_WAKEUP_GPIO ? "button" : "timer", (unsigned long)(sleepDuration / 1000));
+}
+
+// Check if this boot resumes from deep sleep
+bool SleepManager::isWake() const {
+    return wake;
+}
+
+// Get the wake cause of this boot
+esp_sleep_wakeup_cause_t SleepManager::getWakeCause() const {
+    return wakeCause;
+}
+
+// Get the number of deep sleeps since power-up
+uint32_t SleepManager::getSleepCount() const {
+    return retainedState.sleepCount;
+}
+
+// Get the length of the sleep this boot woke from
+uint32_t SleepManager::getSleepDuration() const {
+    return sleepDuration;
+}
+
+// Get the state kept in RTC memory
+SleepManager::RetainedState& SleepManager::getRetainedState() {
+    return retainedState;
+}
+
+// Set a periodic wake in addition to the button
+void SleepManager::setTimerWake(uint32_t seconds) {
+    timerWake = seconds;
+}
+
+// Enter deep sleep, waking on the A button or the timer
+void SleepManager::deepSleep() {
+    // With the latch held high the 4021 loads its inputs continuously, so DATA follows
+    // the first button (A) while the clock line is idle
+    Hal::pinOutput(latchPin);
+    Hal::writePin(latchPin, true);
+    Hal::pinInput(dataPin, true);
+
+    uint32_t start = Hal::millis();
+    while (!Hal::readPin(dataPin) && Hal::millis() - start < RELEASE_TIMEOUT) {
+        Hal::delay(10);
+    }
+
+    gpio_hold_en((gpio_num_t)latchPin);
+    gpio_hold_en((gpio_num_t)dataPin);
+    gpio_deep_sleep_hold_en();
+    esp_deep_sleep_enable_gpio_wakeup(1ULL << dataPin, ESP_GPIO_WAKEUP_GPIO_LOW);
+    if (timerWake > 0) {
+        esp_sleep_enable_timer_wakeup((uint64_t)timerWake * 1000000ULL);
+    }
+
+    retainedState.magic = RETAINED_MAGIC;
+    retainedState.sleepCount++;
+    retainedState.sleepStartTime = rtcTime();
+    Serial.flush();
+    Hal::deepSleep();
+}
+
+// Light sleep for a while, keeping RAM, the BLE stack and millis()
+bool SleepManager::lightSleep(uint32_t milliseconds) {
+    uint32_t start = Hal::micros();
+    if (!Hal::lightSleep(milliseconds)) {
+        return false;
+    }
+    uint32_t slept = Hal::micros() - start;
+
+    standbySleepTime += slept;
+    standbyWakes++;
+    return true;
+}
+
+// Start timing a standby period
+void SleepManager::beginStandby() {
+    Serial.flush();
+    standbyStartTime = esp_timer_get_time();
+}
+
+// Stop timing a standby period
+void SleepManager::endStandby() {
+    standbyTime += esp_timer_get_time() - standbyStartTime;
+}
+
+// Get the number of light sleep wakes in standby
+uint32_t SleepManager::getStandbyWakes() const {
+    return standbyWakes;
+}
+
+// Get the measured awake time per standby wake
+uint32_t SleepManager::getStandbyAwakeTime() const {
+    if (standbyWakes == 0 || standbyTime < standbySleepTime) {
+        return 0;
+    }
+    return (standbyTime - standbySleepTime) / standbyWakes;
+}
+
+// Get the average standby current from the measured awake and asleep times
+uint32_t SleepManager::getStandbyCurrent() const {
+    if (standbyTime == 0 || standbyTime < standbySleepTime) {
+        return 0;
+    }
+    uint64_t awakeTime = standbyTime - standbySleepTime;
+    return (awakeTime * AWAKE_CURRENT + standbySleepTime * LIGHT_SLEEP_CURRENT) / standbyTime;
+}
+
+// Print standby statistics
+void SleepManager::printStandbyStats() const {
+    uint32_t period = standbyWakes > 0 ? standbyTime / standbyWakes : 0;
+    Serial.printf("Standby: %lu s, %lu wakes, %lu us awake per %lu us period, ~%lu uA average\n",
+                  (unsigned long)(standbyTime / 1000000), (unsigned long)standbyWakes,
+                  (unsigned long)getStandbyAwakeTime(), (unsigned long)period, (unsigned long)getStandbyCurrent());
+}
+
+// Read the RTC clock, which keeps running through deep sleep
+int64_t SleepManager::rtcTime() {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
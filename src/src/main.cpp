@@ -16,11 +16,25 @@
 // along with this program.  If not, see <https:#www.gnu.org/licenses/>.
 
 #include <Arduino.h>
+#include "Hal.h"
+#include "NesController.h"
 #include "BLEJoystick.h"
+#include "BatteryMonitor.h"
+#include "SleepManager.h"
+#include "FrequencyPolicy.h"
+#include "EnergyMonitor.h"
+#include "BatteryPolicy.h"
+#include "LedDriver.h"
+#include "ActivityTimers.h"
 
 // --- Battery ADC ---
 #define BATTERY_PIN 0
+#define BATTERY_CAPACITY 1000  // mAh
+#define BATTERY_DIVIDER 2.0  // battery voltage / ADC pin voltage, keeps a full cell inside the ADC range
 #define POWER_KEY_PIN 1
+// TP4057 status outputs, nets BATT_CHRG and BATT_STDBY in pcb/bt-nes-advantage.kicad_pcb
+#define CHARGE_PIN 10  // TP4057 CHRG, open drain, low while charging
+#define STANDBY_PIN 20  // TP4057 STDBY, open drain, low when charge has terminated
 #define CONNECT_LED_PIN 8
 
 // NES Pin Mapping
@@ -28,175 +42,236 @@
 #define LATCH_PIN 3
 #define DATA_PIN 4
 
-// Button mapping (NES to HID bit positions)
-#define NES_BUTTON_A 0
-#define NES_BUTTON_B 1
-#define NES_BUTTON_SELECT 2
-#define NES_BUTTON_START 3
-#define NES_BUTTON_UP 4
-#define NES_BUTTON_DOWN 5
-#define NES_BUTTON_LEFT 6
-#define NES_BUTTON_RIGHT 7
-
 #define IDLE_TIMEOUT 60000  // milliseconds
 #define ADVERTISING_TIMEOUT 30000  // milliseconds
+#define CONN_IDLE_TIMEOUT 10000  // milliseconds without input before the connected-inactive mode
+#define INACTIVE_POLL_INTERVAL 16  // milliseconds between controller reads in the connected-inactive mode, at most BLEJoystick::MIN_TAP_DURATION
+#define LOW_BATTERY_POLL_INTERVAL 16  // milliseconds between controller reads from the critical battery stage, at most BLEJoystick::MIN_TAP_DURATION
+#define LOW_BATTERY_TX_POWER ESP_PWR_LVL_N0  // TX power cap from the critical battery stage
+#define LED_CONNECTED_LEVEL 64  // connection light brightness (of 255) while connected
+#define LED_DIM_LEVEL 8  // connection light brightness (of 255) in the connected-inactive mode or on low battery
+#define LED_BREATHE_PERIOD 2000  // milliseconds per breath while reconnecting to the last host
+#define LOAD_CURRENT_AWAKE 20  // mA, rough average draw with the CPU running
+#define LOAD_CURRENT_ADVERTISING 6  // mA added while advertising
+#define LOAD_CURRENT_ACTIVE_LINK 9  // mA added per host on the active connection profile
+#define LOAD_CURRENT_IDLE_LINK 2  // mA added per host on the idle connection profile
+#define STANDBY_POLL_INTERVAL 50  // milliseconds of light sleep between controller reads in standby
+#define STANDBY_TIMEOUT 14400000  // milliseconds in standby before deep sleep (4 hours)
+#define SLEEP_TIMER_WAKE 0  // seconds, 0 = deep sleep until the A button is pressed
+#define POLL_INTERVAL 10  // milliseconds between controller reads
+#define SUSPENDED_POLL_INTERVAL 50  // milliseconds between controller reads while the host suspended HID, taps may be missed
 
 // Global objects
+NesController* pad;
 BLEJoystick* joystick;
-bool buttonState[8] = {false};
-bool prevButtonState[8] = {false};
-unsigned long lastActivityTime = 0;
-unsigned long advertisingStartTime = 0;
+BatteryMonitor* battery;
+SleepManager* sleepManager;
+FrequencyPolicy* frequencyPolicy;
+EnergyMonitor* energy;
+BatteryPolicy* batteryPolicy;
+LedDriver* connectionLight;
+ActivityTimers* timers;
 int batteryLevel = 0;
 int prevBatteryLevel = 0;
-unsigned long startButtonPressTime = 0;
-unsigned long selectButtonPressTime = 0;
-const unsigned long POWER_OFF_HOLD_TIME = 5000; // 5 seconds
-const unsigned long RECONNECT_HOLD_TIME = 5000; // 5 seconds
+uint8_t chargeState = BatteryMonitor::CHARGE_UNKNOWN;
 
 // Function prototypes
 void joystickStateCallback();
-int readBatteryLevel();
-void readNESController();
+int estimateLoadCurrent();
 void powerOn();
 void powerOff();
-void connectionLightOn();
-void connectionLightOff();
+void standby();
+void updateConnectionLight();
+void leaveInactive();
+unsigned long pollInterval();
+void applyBatteryStage();
 void checkTimers();
+void updateChargeState();
+uint8_t frequencyProfile();
+uint8_t energyState();
 
 void setup() {
   // Initialize serial for debugging
   Serial.begin(115200);
   Serial.println("NES Advantage BLE Controller starting...");
   
+  // Cold boot or wake from deep sleep, before touching pins held through sleep
+  sleepManager = new SleepManager(LATCH_PIN, DATA_PIN);
+  sleepManager->begin();
+  sleepManager->setTimerWake(SLEEP_TIMER_WAKE);
+  bool wake = sleepManager->isWake();
+  
+  // Account energy per state, carrying the totals across deep sleep
+  energy = new EnergyMonitor();
+  energy->setCapacity(BATTERY_CAPACITY);
+  if (wake) {
+    energy->restore(sleepManager->getRetainedState().energy);
+    energy->addStateTime(EnergyMonitor::STATE_SLEEP, sleepManager->getSleepDuration());
+  }
+  
   // Configure pins
-  pinMode(POWER_KEY_PIN, OUTPUT);
-  pinMode(CONNECT_LED_PIN, OUTPUT);
-  pinMode(CLK_PIN, OUTPUT);
-  pinMode(LATCH_PIN, OUTPUT);
-  pinMode(DATA_PIN, INPUT_PULLUP);
+  Hal::setPowerKeyPin(POWER_KEY_PIN);
+  pad = new NesController(CLK_PIN, LATCH_PIN, DATA_PIN);
+  pad->begin();
+  timers = new ActivityTimers(IDLE_TIMEOUT, ADVERTISING_TIMEOUT, CONN_IDLE_TIMEOUT);
+  
+  // Turn power on, the power key stayed on through deep sleep
+  if (wake) {
+    Hal::releasePowerKey();
+  } else {
+    powerOn();
+  }
   
-  // Turn power on
-  powerOn();
+  // Connection light on the LEDC peripheral, patterns keep running without the CPU
+  connectionLight = new LedDriver(CONNECT_LED_PIN);
+  connectionLight->begin();
   
-  // Initialize the joystick
-  joystick = new BLEJoystick("NES Advantage");
+  // Measure the battery before the radio starts
+  battery = new BatteryMonitor(BATTERY_PIN, BATTERY_DIVIDER);
+  battery->begin();
+  battery->setRadioQuietCallback([]() { return joystick == nullptr || joystick->isRadioQuiet(); });
+  battery->setChargePins(CHARGE_PIN, STANDBY_PIN);
+  battery->setLoadCurrent(LOAD_CURRENT_AWAKE);
+  battery->measure();
+  if (wake) {
+    battery->restoreLevel(sleepManager->getRetainedState().batteryLevel);
+  }
+  
+  // Degrade gracefully as the battery runs out
+  batteryPolicy = new BatteryPolicy();
+  
+  // Scale the CPU clock with the workload
+  frequencyPolicy = new FrequencyPolicy();
+  frequencyPolicy->begin();
+  
+  // Initialize the joystick, reconnecting to the last host from RTC memory after a wake
+  joystick = new BLEJoystick("NES Advantage", wake ? &sleepManager->getRetainedState().link : nullptr);
   joystick->setStateChangeCallback(joystickStateCallback);
   
   // Start the joystick
   joystick->start();
   joystick->startAdvertising();
-  advertisingStartTime = millis();
+  timers->markAdvertisingStart(Hal::millis());
   
   // Initial battery reading
-  batteryLevel = readBatteryLevel();
+  batteryLevel = battery->getLevel();
   prevBatteryLevel = batteryLevel;
+  updateChargeState();
+  if (batteryPolicy->update(batteryLevel, battery->getMilliVolts(), battery->isExternalPower())) {
+    applyBatteryStage();
+  }
 }
 
 void loop() {
-  // Read controller state
-  readNESController();
+  // Read controller state, the input/report path runs at full clock
+  unsigned long readTime = Hal::millis();
+  frequencyPolicy->beginWork();
   
-  // Check if state has changed
-  bool stateChanged = false;
-  for (int i = 0; i < 8; i++) {
-    if (buttonState[i] != prevButtonState[i]) {
-      stateChanged = true;
-      prevButtonState[i] = buttonState[i];
-    }
-  }
-  
-  // Update joystick if state changed
-  if (stateChanged) {
+  // Update joystick if state changed, a press leaving the connected-inactive mode is timed from this read
+  unsigned long edgeTime = Hal::micros();
+  if (pad->read()) {
     Serial.print("NES state change: ");
-    for (int i = 0; i < 8; i++) {
-      Serial.print(buttonState[i] ? "1" : "0");
+    for (uint8_t i = 0; i < NesController::BUTTON_COUNT; i++) {
+      Serial.print(pad->isPressed(i) ? "1" : "0");
     }
     Serial.println();
     
-    // Calculate hat direction
-    uint8_t dpadDirection = 0;
-    if (buttonState[NES_BUTTON_UP] && buttonState[NES_BUTTON_RIGHT]) {
-      dpadDirection = 2;
-    } else if (buttonState[NES_BUTTON_RIGHT] && buttonState[NES_BUTTON_DOWN]) {
-      dpadDirection = 4;
-    } else if (buttonState[NES_BUTTON_DOWN] && buttonState[NES_BUTTON_LEFT]) {
-      dpadDirection = 6;
-    } else if (buttonState[NES_BUTTON_LEFT] && buttonState[NES_BUTTON_UP]) {
-      dpadDirection = 8;
-    } else if (buttonState[NES_BUTTON_UP]) {
-      dpadDirection = 1;
-    } else if (buttonState[NES_BUTTON_RIGHT]) {
-      dpadDirection = 3;
-    } else if (buttonState[NES_BUTTON_DOWN]) {
-      dpadDirection = 5;
-    } else if (buttonState[NES_BUTTON_LEFT]) {
-      dpadDirection = 7;
-    } else {
-      dpadDirection = 0;
-    }
-    
-    // Update axis values from directional buttons
-    int8_t x = buttonState[NES_BUTTON_RIGHT] ? 127 : (buttonState[NES_BUTTON_LEFT] ? -127 : 0);
-    int8_t y = buttonState[NES_BUTTON_DOWN] ? 127 : (buttonState[NES_BUTTON_UP] ? -127 : 0);
-    
     if (joystick->getState() == BLEJoystick::DEVICE_CONNECTED) {
-      joystick->setHat(dpadDirection);
+      bool firstPress = timers->isInactive();
+      if (firstPress) {
+        joystick->markFirstPress(edgeTime);
+      }
+      joystick->setHat(pad->getHat());
       joystick->setButtons(
-        buttonState[NES_BUTTON_A],  // A button
-        buttonState[NES_BUTTON_B],  // B button
+        pad->isReported(NesController::BUTTON_A),  // A button
+        pad->isReported(NesController::BUTTON_B),  // B button
         false, false,               // buttons 3-4
         false, false,               // buttons 5-6
         false, false,               // buttons 7-8
         false, false,               // buttons 9-10
-        buttonState[NES_BUTTON_SELECT],  // Select button
-        buttonState[NES_BUTTON_START]    // Start button
+        pad->isReported(NesController::BUTTON_SELECT),  // Select button
+        pad->isReported(NesController::BUTTON_START)    // Start button
       );
       joystick->notifyHIDReport();
-      lastActivityTime = millis();
-    } else if (joystick->getState() == BLEJoystick::DEVICE_IDLE && selectButtonPressTime == 0) {
+      timers->markActivity(Hal::millis());
+      if (firstPress) {
+        leaveInactive();
+      }
+    } else if (joystick->getState() == BLEJoystick::DEVICE_IDLE && !pad->isSelectHeld()) {
       Serial.println("Start advertising ...");
       joystick->startAdvertising();
-      advertisingStartTime = millis();
+      timers->markAdvertisingStart(Hal::millis());
     }
   }
   
-  // Check battery level periodically
-  static unsigned long lastBatteryCheck = 0;
-  if (millis() - lastBatteryCheck > 5000) {  // Check every 5 seconds
-    batteryLevel = readBatteryLevel();
+  // Retry reports a congested host could not take
+  joystick->flushReports();
+  frequencyPolicy->endWork();
+  frequencyPolicy->setProfile(frequencyProfile());
+  energy->setState(energyState());
+  energy->update(joystick->getNotifyCount(), frequencyPolicy->getBusyTime());
+  
+  // Sample link quality and adapt TX power
+  joystick->updateLinkQuality();
+  
+  // Print link or CPU statistics on request
+  if (Serial.available() > 0) {
+    char command = Serial.read();
+    if (command == 's') {
+      joystick->printLinkStats();
+    } else if (command == 'p') {
+      frequencyPolicy->printStats();
+    } else if (command == 'e') {
+      energy->printStats(batteryLevel);
+    }
+  }
+  
+  // The battery is sampled between radio bursts in the background, update the level when a measurement completes
+  battery->setLoadCurrent(estimateLoadCurrent());
+  if (battery->update()) {
+    batteryLevel = battery->getLevel();
+    EnergyMonitor::EnergyReport report = energy->getReport(batteryLevel);
+    joystick->setEnergyReport((uint8_t*)&report, sizeof(report));
     if (batteryLevel != prevBatteryLevel && joystick->getState() == BLEJoystick::DEVICE_CONNECTED) {
       prevBatteryLevel = batteryLevel;
       joystick->setBatteryLevel(batteryLevel);
       joystick->notifyBatteryLevel();
     }
-    lastBatteryCheck = millis();
+    if (batteryPolicy->update(batteryLevel, battery->getMilliVolts(), battery->isExternalPower())) {
+      applyBatteryStage();
+    }
   }
+  updateChargeState();
   
   // Check timers for idle and advertising timeouts
   checkTimers();
   
-  // Short delay to prevent CPU hogging
-  delay(10);
+  // Precompute the pairing key pair on the first pass, off the NimBLE host task
+  joystick->generatePairingKey();
+  
+  // Short delay to prevent CPU hogging, longer in the low-power modes on battery. Timed from the
+  // read so the work above doesn't stretch the read interval past BLEJoystick::MIN_TAP_DURATION
+  unsigned long elapsed = Hal::millis() - readTime;
+  unsigned long interval = pollInterval();
+  Hal::delay(elapsed < interval ? interval - elapsed : 0);
 }
 
 void joystickStateCallback() {
+  timers->leaveInactive();
   switch (joystick->getState()) {
     case BLEJoystick::DEVICE_IDLE:
       Serial.println("Device idle.");
-      connectionLightOff();
-      lastActivityTime = millis();
+      timers->markActivity(Hal::millis());
       break;
       
     case BLEJoystick::DEVICE_ADVERTISING:
       Serial.println("Device advertising.");
-      advertisingStartTime = millis();
+      timers->markAdvertisingStart(Hal::millis());
       break;
       
     case BLEJoystick::DEVICE_CONNECTED:
       Serial.println("Device connected.");
-      connectionLightOn();
-      lastActivityTime = millis();
+      timers->markActivity(Hal::millis());
       // Send initial battery level
       joystick->setBatteryLevel(batteryLevel);
       joystick->notifyBatteryLevel();
@@ -205,124 +280,236 @@ void joystickStateCallback() {
     default:
       break;
   }
+  updateConnectionLight();
 }
 
-int readBatteryLevel() {
-  int raw = analogRead(BATTERY_PIN);
-  float voltage = (raw / 4095.0) * 3.3;  // ESP32 has 12-bit ADC
-  int percentage = min(100, static_cast<int>((voltage / 3.0) * 100));
-  return percentage;
-}
-
-void readNESController() {
-  // Latch current button states
-  digitalWrite(LATCH_PIN, HIGH);
-  delayMicroseconds(12);  // Latch pulse (min 12µs)
-  digitalWrite(LATCH_PIN, LOW);
-  
-  // Read all 8 buttons
-  for (int i = 0; i < 8; i++) {
-    // NES buttons are active low, so invert the reading
-    buttonState[i] = !digitalRead(DATA_PIN);
-    
-    // Clock pulse
-    digitalWrite(CLK_PIN, HIGH);
-    delayMicroseconds(6);
-    digitalWrite(CLK_PIN, LOW);
-    delayMicroseconds(6);
+int estimateLoadCurrent() {
+  // Recent radio activity keeps the cell sagged even when sampled between bursts
+  int current = LOAD_CURRENT_AWAKE;
+  if (joystick->isAdvertising()) {
+    current += LOAD_CURRENT_ADVERTISING;
+  }
+  for (uint8_t i = 0; i < joystick->getPeerCount(); i++) {
+    current += joystick->getConnProfile(i) == BLEJoystick::CONN_PROFILE_ACTIVE ? LOAD_CURRENT_ACTIVE_LINK
+                                                                                 : LOAD_CURRENT_IDLE_LINK;
   }
+  return current;
 }
 
 void powerOn() {
   Serial.println("Powering on ...");
-  digitalWrite(POWER_KEY_PIN, LOW);
-  delay(200);
-  digitalWrite(POWER_KEY_PIN, HIGH);
+  Hal::pressPowerKey(200);
 }
 
 void powerOff() {
   Serial.println("Powering off ...");
   // Sequence to trigger power off
-  digitalWrite(POWER_KEY_PIN, LOW);
-  delay(100);
-  digitalWrite(POWER_KEY_PIN, HIGH);
-  delay(100);
-  digitalWrite(POWER_KEY_PIN, LOW);
-  delay(100);
-  digitalWrite(POWER_KEY_PIN, HIGH);
+  Hal::pressPowerKey(100);
+  Hal::delay(100);
+  Hal::pressPowerKey(100);
   
-  // Deep sleep
-  esp_deep_sleep_start();
+  // Deep sleep until the A button is pressed, keeping what the reconnect needs in RTC memory
+  SleepManager::RetainedState& state = sleepManager->getRetainedState();
+  joystick->retainState(state.link);
+  energy->retain(state.energy);
+  state.batteryLevel = battery->getLevel();
+  connectionLight->end();
+  sleepManager->deepSleep();
 }
 
-void connectionLightOn() {
-  digitalWrite(CONNECT_LED_PIN, LOW);  // Active low
+uint8_t frequencyProfile() {
+  if (joystick->getState() == BLEJoystick::DEVICE_CONNECTED) {
+    return joystick->getConnProfile() == BLEJoystick::CONN_PROFILE_ACTIVE ? FrequencyPolicy::PROFILE_PLAY
+                                                                          : FrequencyPolicy::PROFILE_CONNECTED_IDLE;
+  }
+  if (joystick->getState() == BLEJoystick::DEVICE_ADVERTISING || joystick->isAdvertising()) {
+    return FrequencyPolicy::PROFILE_ADVERTISING;
+  }
+  return FrequencyPolicy::PROFILE_IDLE;
 }
 
-void connectionLightOff() {
-  digitalWrite(CONNECT_LED_PIN, HIGH); // Active low
+uint8_t energyState() {
+  switch (joystick->getState()) {
+    case BLEJoystick::DEVICE_CONNECTED:
+      return joystick->getConnProfile() == BLEJoystick::CONN_PROFILE_ACTIVE ? EnergyMonitor::STATE_CONNECTED_ACTIVE
+                                                                            : EnergyMonitor::STATE_CONNECTED_IDLE;
+    case BLEJoystick::DEVICE_ADVERTISING:
+      return EnergyMonitor::STATE_ADVERTISING;
+    case BLEJoystick::DEVICE_IDLE:
+      return joystick->isAdvertising() ? EnergyMonitor::STATE_ADVERTISING : EnergyMonitor::STATE_IDLE;
+    default:
+      return EnergyMonitor::STATE_STOPPED;
+  }
 }
 
-void checkTimers() {
-  unsigned long currentTime = millis();
+void standby() {
+  // Light sleep between controller reads until any button is pressed
+  connectionLight->off();
+  energy->setState(EnergyMonitor::STATE_STANDBY);
+  sleepManager->beginStandby();
+  bool pressed = timers->waitForPress(*pad, STANDBY_TIMEOUT, STANDBY_POLL_INTERVAL, [](uint32_t milliseconds) {
+    if (!sleepManager->lightSleep(milliseconds)) {
+      Hal::delay(milliseconds);
+    }
+  });
+  sleepManager->endStandby();
+  if (!pressed) {
+    Serial.println("Standby for too long, going to sleep...");
+    powerOff();
+  }
   
-  // Check if device is idle for too long
-  if (joystick->getState() == BLEJoystick::DEVICE_IDLE && 
-      currentTime - lastActivityTime > IDLE_TIMEOUT) {
-    Serial.println("Device idle for too long, going to sleep...");
+  Serial.println("Button pressed, leaving standby...");
+  sleepManager->printStandbyStats();
+  joystick->startAdvertising();
+  timers->markAdvertisingStart(Hal::millis());
+}
+
+void updateConnectionLight() {
+  // Patterns run on the LEDC peripheral, asking for the running one again is free
+  bool lowBattery = batteryPolicy->getStage() >= BatteryPolicy::STAGE_LOW;
+  if (joystick->getState() == BLEJoystick::DEVICE_CONNECTED) {
+    bool dim = (timers->isInactive() && !battery->isExternalPower()) || lowBattery;
+    connectionLight->on(dim ? LED_DIM_LEVEL : LED_CONNECTED_LEVEL);
+  } else if (joystick->getState() == BLEJoystick::DEVICE_ADVERTISING && !lowBattery) {
+    if (joystick->isReconnecting()) {
+      connectionLight->breathe(LED_BREATHE_PERIOD);
+    } else {
+      connectionLight->blink();
+    }
+  } else {
+    connectionLight->off();
+  }
+}
+
+unsigned long pollInterval() {
+  if (battery->isExternalPower()) {
+    return POLL_INTERVAL;
+  }
+  if (joystick->isSuspended()) {
+    return SUSPENDED_POLL_INTERVAL;
+  }
+  if (timers->isInactive()) {
+    return INACTIVE_POLL_INTERVAL;
+  }
+  return batteryPolicy->getStage() >= BatteryPolicy::STAGE_CRITICAL ? LOW_BATTERY_POLL_INTERVAL : POLL_INTERVAL;
+}
+
+void applyBatteryStage() {
+  uint8_t stage = batteryPolicy->getStage();
+  Serial.printf("Battery %d%% (%u mV), %s stage\n", batteryLevel, battery->getMilliVolts(),
+                batteryPolicy->getStageName());
+  
+  // Announce every transition, even without a level change
+  joystick->setBatteryCritical(stage >= BatteryPolicy::STAGE_CRITICAL);
+  joystick->setBatteryLevel(batteryLevel);
+  joystick->notifyBatteryLevel();
+  prevBatteryLevel = batteryLevel;
+  
+  joystick->setTxPowerLimit(stage >= BatteryPolicy::STAGE_CRITICAL ? LOW_BATTERY_TX_POWER : BLEJoystick::TX_POWER_MAX);
+  updateConnectionLight();
+  
+  if (stage == BatteryPolicy::STAGE_SHUTDOWN) {
+    // Leave the host cleanly instead of browning out mid-game
+    Serial.println("Battery empty, shutting down...");
+    Hal::delay(100);  // Let the battery notification go out
+    joystick->disconnect();
+    Hal::delay(100);
     powerOff();
   }
+}
+
+void leaveInactive() {
+  // The joystick times the press to its report and publishes the worst case
+  Serial.println("Input again, leaving the connected-inactive mode");
+  
+  timers->leaveInactive();
+  updateConnectionLight();
+}
+
+void checkTimers() {
+  unsigned long currentTime = Hal::millis();
+  uint8_t actions = timers->check(currentTime, joystick->getState() == BLEJoystick::DEVICE_IDLE,
+                                  joystick->getState() == BLEJoystick::DEVICE_CONNECTED,
+                                  joystick->getState() == BLEJoystick::DEVICE_ADVERTISING || joystick->isAdvertising(),
+                                  battery->isExternalPower());
+  
+  // Idle for too long
+  if (actions & ActivityTimers::ACTION_STANDBY) {
+    Serial.println("Device idle for too long, entering standby...");
+    standby();
+    
+    // Hours may have passed, the next check starts from a fresh time
+    return;
+  }
+  
+  // Connected but not playing: relax the link, and on battery poll slower and dim the light
+  if (actions & ActivityTimers::ACTION_ENTER_INACTIVE) {
+    Serial.println("No input for a while, entering connected-inactive mode...");
+    if (joystick->getConnProfile() == BLEJoystick::CONN_PROFILE_ACTIVE) {
+      joystick->requestIdleConnParams();
+    }
+    updateConnectionLight();
+  }
   
-  // Check if device is advertising for too long
-  if (joystick->getState() == BLEJoystick::DEVICE_ADVERTISING && 
-      currentTime - advertisingStartTime > ADVERTISING_TIMEOUT) {
+  // Advertising for too long
+  if (actions & ActivityTimers::ACTION_STOP_ADVERTISING) {
     Serial.println("Device advertising for too long, stopping...");
     joystick->stopAdvertising();
-    connectionLightOff();
-  } else if (joystick->getState() == BLEJoystick::DEVICE_ADVERTISING) {
-    // Blink LED while advertising
-    digitalWrite(CONNECT_LED_PIN, (currentTime / 500) % 2 == 0);
+  } else if (joystick->isReconnecting() != (connectionLight->getPattern() == LedDriver::PATTERN_BREATHE)) {
+    // Directed advertising fell back to undirected without a state change
+    updateConnectionLight();
   }
 
- // Check for start button long press (power off)
-  if (buttonState[NES_BUTTON_START]) {
-    // Start button pressed or still being held
-    if (startButtonPressTime == 0) {
-      // Just pressed, record time
-      startButtonPressTime = currentTime;
-    } else if (currentTime - startButtonPressTime >= POWER_OFF_HOLD_TIME) {
-      // Held for the required duration, power off
-      Serial.println("Start button held for 5 seconds, powering off...");
-      powerOff();
+  // Hold and chord gestures
+  uint8_t events = pad->updateGestures(currentTime);
+  if (events & NesController::EVENT_POWER_OFF) {
+    Serial.println("Start button held for 5 seconds, powering off...");
+    powerOff();
+  }
+  if (events & NesController::EVENT_NEXT_HOST) {
+    joystick->nextHost();
+  }
+  if (events & NesController::EVENT_ADD_HOST) {
+    // Let another host connect alongside the current one
+    if (joystick->getState() == BLEJoystick::DEVICE_CONNECTED && !joystick->isAdvertising()) {
+      Serial.println("Advertising for an additional host ...");
+      joystick->startAdvertising();
+      timers->markAdvertisingStart(Hal::millis());
     }
-  } else {
-    // Start button released
-    startButtonPressTime = 0;
   }
-  
-  // Check for select button long press (disconnect and restart advertising)
-  if (buttonState[NES_BUTTON_SELECT]) {
-    // Select button pressed or still being held
-    if (selectButtonPressTime == 0) {
-      // Just pressed, record time
-      selectButtonPressTime = currentTime;
-    } else if (currentTime - selectButtonPressTime >= RECONNECT_HOLD_TIME) {
-      // Held for the required duration, disconnect and start advertising
-      Serial.println("Select button held for 5 seconds, disconnecting ...");
-      
-      // Only perform the action once when threshold is reached
-      selectButtonPressTime = 0;
+  if (events & NesController::EVENT_RECONNECT) {
+    Serial.println("Select button held for 5 seconds, disconnecting ...");
     
-      // If connected, disconnect first
-      if (joystick->getState() == BLEJoystick::DEVICE_CONNECTED) {
-        joystick->disconnect();
-      } else {
-        // Stop any current advertising
-        joystick->stopAdvertising();
-      }
+    // If connected, disconnect first
+    if (joystick->getState() == BLEJoystick::DEVICE_CONNECTED) {
+      joystick->disconnect();
+    } else {
+      // Stop any current advertising
+      joystick->stopAdvertising();
     }
-  } else {
-    // Select button released
-    selectButtonPressTime = 0;
   }
 }
+
+void updateChargeState() {
+  if (battery->getChargeState() == chargeState) {
+    return;
+  }
+  
+  chargeState = battery->getChargeState();
+  switch (chargeState) {
+    case BatteryMonitor::CHARGE_CHARGING:
+      Serial.println("Charging.");
+      break;
+      
+    case BatteryMonitor::CHARGE_FULL:
+      Serial.println("Charge complete.");
+      break;
+      
+    default:
+      Serial.println("Running on battery.");
+      timers->markActivity(Hal::millis());  // Full idle timeout after unplugging
+      break;
+  }
+  joystick->setPowerState(battery->isExternalPower(), chargeState == BatteryMonitor::CHARGE_CHARGING);
+  updateConnectionLight();  // dimmed while inactive on battery only
+}
@@ -0,0 +1,225 @@
+// main.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// Native build entry point: runs the input logic and the activity timers
+// against a simulated pad, runs BLEJoystick against the NimBLE stand-in and
+// times both hot paths on the host.
+
+#include <stdio.h>
+#include <Arduino.h>
+#include "Hal.h"
+#include "NesController.h"
+#include "ActivityTimers.h"
+#include "BLEJoystick.h"
+#include "NimBLEFake.h"
+
+// pio test links this file with the tests, which bring their own main
+#ifndef PIO_UNIT_TESTING
+
+#define CLK_PIN 2
+#define LATCH_PIN 3
+#define DATA_PIN 4
+
+#define READ_COUNT 10000
+#define POLL_INTERVAL 10  // milliseconds of simulated time per read
+
+#define IDLE_TIMEOUT 60000
+#define ADVERTISING_TIMEOUT 30000
+#define CONN_IDLE_TIMEOUT 10000
+#define STANDBY_TIMEOUT 1000
+#define STANDBY_SLEEPS 3  // light sleeps before the simulated press
+
+#define REPORT_COUNT 10000
+#define CONGESTED_REPORTS 24
+#define HOST_ADDRESS "c0:ff:ee:00:00:01"
+
+// Simulated 4021: loads while latched, shifts on each rising clock
+static uint8_t pressedButtons = 0;
+static uint8_t shiftIndex = 0;
+
+static void onOutput(uint8_t pin, bool high) {
+  if (pin == LATCH_PIN && high) {
+    shiftIndex = 0;
+  } else if (pin == CLK_PIN && high) {
+    shiftIndex++;
+  }
+}
+
+static bool onInput(uint8_t pin) {
+  if (pin != DATA_PIN) {
+    return true;
+  }
+  // Active low, past the last button the serial input reads high
+  return shiftIndex >= NesController::BUTTON_COUNT || !((pressedButtons >> shiftIndex) & 1);
+}
+
+// Hold buttons through simulated time and report the gestures seen
+static void simulate(NesController& pad, uint8_t buttons, uint32_t& now, uint32_t duration) {
+  pressedButtons = buttons;
+  for (uint32_t end = now + duration; now < end; now += POLL_INTERVAL) {
+    if (pad.read()) {
+      printf("%7u ms  buttons 0x%02x  hat %u  x %4d  y %4d\n", now, pad.getButtons(), pad.getHat(), pad.getX(),
+             pad.getY());
+    }
+    uint8_t events = pad.updateGestures(now);
+    if (events & NesController::EVENT_POWER_OFF) {
+      printf("%7u ms  power off\n", now);
+    }
+    if (events & NesController::EVENT_RECONNECT) {
+      printf("%7u ms  reconnect\n", now);
+    }
+    if (events & NesController::EVENT_NEXT_HOST) {
+      printf("%7u ms  next host\n", now);
+    }
+    if (events & NesController::EVENT_ADD_HOST) {
+      printf("%7u ms  add host\n", now);
+    }
+  }
+}
+
+// Idle into standby, wake it with START held, then run the checks that follow the wake
+static void simulateStandby(NesController& pad) {
+  ActivityTimers timers(IDLE_TIMEOUT, ADVERTISING_TIMEOUT, CONN_IDLE_TIMEOUT);
+  uint8_t actions = timers.check(IDLE_TIMEOUT + 1, true, false, false, false);
+  printf("Idle for %u ms: actions 0x%02x\n", IDLE_TIMEOUT + 1, actions);
+
+  pressedButtons = 0;
+  uint32_t sleeps = 0;
+  bool pressed = timers.waitForPress(pad, STANDBY_TIMEOUT, POLL_INTERVAL, [&sleeps](uint32_t milliseconds) {
+    Hal::delay(milliseconds);
+    if (++sleeps == STANDBY_SLEEPS) {
+      pressedButtons = 1 << NesController::BUTTON_START;
+    }
+  });
+  printf("Standby: %s after %u sleeps\n", pressed ? "woken" : "timed out", sleeps);
+
+  // Advertising restarted on the wake and START only just went down
+  uint32_t now = Hal::millis() + POLL_INTERVAL;
+  actions = timers.check(now, false, false, true, false);
+  uint8_t events = pad.updateGestures(now);
+  printf("After the wake: actions 0x%02x, gestures 0x%02x\n", actions, events);
+  pressedButtons = 0;
+  pad.read();
+  pad.updateGestures(now + POLL_INTERVAL);
+}
+
+// Print one connection's counters as BLEJoystick sees them
+static void printPeer(BLEJoystick& joystick) {
+  const BLEJoystick::PeerLink* peer = joystick.getPeer(0);
+  if (peer == nullptr) {
+    printf("No peer\n");
+    return;
+  }
+  printf("Peer: interval %u, PHY %u, subscribed %u, sent %u, failed %u (%u no mbuf), deferred %u, queued %u, "
+         "recovered %u, merged %u, dropped %u\n",
+         peer->connInterval, peer->txPhy, peer->subscribed, peer->notifySent, peer->notifyFailed,
+         peer->mbufExhausted, peer->notifyDeferred, peer->queueCount, peer->statesRecovered, peer->statesMerged,
+         peer->statesDropped);
+}
+
+// Connect a host, congest the link and time the notify path
+static void simulateHost() {
+  BLEJoystick joystick("NES Advantage");
+  joystick.setStateChangeCallback([&joystick]() { printf("State %u\n", joystick.getState()); });
+  joystick.start();
+  joystick.startAdvertising();
+  joystick.generatePairingKey();
+  NimBLEFake::runHostTasks();
+
+  // Pair and subscribe like a new host, then let the stack settle the link
+  NimBLECharacteristic* input = NimBLEFake::getCharacteristic(NimBLEUUID((uint16_t)0x2A4D));
+  uint16_t connHandle = NimBLEFake::connect(NimBLEAddress(HOST_ADDRESS));
+  NimBLEFake::encrypt(connHandle);
+  NimBLEFake::subscribe(connHandle, input);
+  NimBLEFake::runHostTasks();
+  joystick.flushReports();
+  printPeer(joystick);
+
+  // Notify path with the debug dump muted, so the terminal is not timed
+  Serial.setMuted(true);
+  NimBLEFake::clearNotifications();
+  uint32_t worst = 0;
+  uint32_t start = Hal::micros();
+  for (uint32_t i = 0; i < REPORT_COUNT; i++) {
+    joystick.setButtons(i & 1, i & 2);
+    joystick.setHat(i % 9);
+    uint32_t reportStart = Hal::micros();
+    joystick.notifyHIDReport();
+    uint32_t reportTime = Hal::micros() - reportStart;
+    if (reportTime > worst) {
+      worst = reportTime;
+    }
+  }
+  uint32_t total = Hal::micros() - start;
+  Serial.setMuted(false);
+  printf("HID report: %u us average, %u us worst over %u reports, %u notified\n", total / REPORT_COUNT, worst,
+         REPORT_COUNT, (unsigned)NimBLEFake::getNotifications().size());
+
+  // Congested link: buffers run out, the queue keeps the states, a connection event drains it
+  Serial.setMuted(true);
+  NimBLEFake::clearNotifications();
+  NimBLEFake::setCongested(true);
+  for (uint32_t i = 0; i < CONGESTED_REPORTS; i++) {
+    joystick.setButtons(i & 1, i & 2, i & 4);
+    joystick.notifyHIDReport();
+  }
+  printf("Congested: %u held, %d buffers free\n", NimBLEFake::getPendingTx(connHandle), os_msys_num_free());
+  NimBLEFake::setCongested(false);
+  NimBLEFake::runHostTasks();
+  joystick.flushReports();
+  Serial.setMuted(false);
+  const std::vector<NimBLEFake::Notification>& notifications = NimBLEFake::getNotifications();
+  if (!notifications.empty()) {
+    printf("Drained: %u notified over %u us\n", (unsigned)notifications.size(),
+           notifications.back().time - notifications.front().time);
+  }
+  printPeer(joystick);
+
+  // Lose the link
+  NimBLEFake::disconnect(connHandle, NimBLEFake::REASON_SUPERVISION_TIMEOUT);
+  printf("Supervision timeouts: %u, bonds: %d\n", joystick.getSupervisionTimeouts(), NimBLEDevice::getNumBonds());
+  NimBLEFake::reset();
+}
+
+int main() {
+  Hal::setOutputHook(onOutput);
+  Hal::setInputHook(onInput);
+  NesController pad(CLK_PIN, LATCH_PIN, DATA_PIN);
+  pad.begin();
+
+  // Gestures on simulated time, starting past 0 which the hold timers treat as unset
+  uint32_t now = POLL_INTERVAL;
+  simulate(pad, 0, now, 100);
+  simulate(pad, 1 << NesController::BUTTON_UP | 1 << NesController::BUTTON_RIGHT, now, 100);
+  simulate(pad, 1 << NesController::BUTTON_SELECT | 1 << NesController::BUTTON_A, now,
+           NesController::CHORD_HOLD_TIME + 100);
+  simulate(pad, 0, now, 100);
+  simulate(pad, 1 << NesController::BUTTON_SELECT | 1 << NesController::BUTTON_B, now,
+           NesController::CHORD_HOLD_TIME + 100);
+  simulate(pad, 0, now, 100);
+  simulate(pad, 1 << NesController::BUTTON_SELECT, now, NesController::RECONNECT_HOLD_TIME + 100);
+  simulate(pad, 1 << NesController::BUTTON_START, now, NesController::POWER_OFF_HOLD_TIME + POLL_INTERVAL);
+  simulate(pad, 0, now, 100);
+
+  // Read path on real time, including the shift register pulse delays
+  uint32_t worst = 0;
+  uint32_t start = Hal::micros();
+  for (uint32_t i = 0; i < READ_COUNT; i++) {
+    pressedButtons = i & 0xFF;
+    uint32_t readStart = Hal::micros();
+    pad.read();
+    uint32_t readTime = Hal::micros() - readStart;
+    if (readTime > worst) {
+      worst = readTime;
+    }
+  }
+  uint32_t total = Hal::micros() - start;
+  printf("Controller read: %u us average, %u us worst over %u reads\n", total / READ_COUNT, worst, READ_COUNT);
+
+  simulateStandby(pad);
+  simulateHost();
+  return 0;
+}
+
+#endif // PIO_UNIT_TESTING
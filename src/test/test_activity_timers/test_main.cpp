@@ -0,0 +1,153 @@
+// test_main.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// Idle, advertising and connected-inactive timeouts, and leaving standby with
+// a simulated pad.
+
+#include <unity.h>
+#include "Hal.h"
+#include "NesController.h"
+#include "ActivityTimers.h"
+
+#define CLK_PIN 2
+#define LATCH_PIN 3
+#define DATA_PIN 4
+
+#define IDLE_TIMEOUT 60000
+#define ADVERTISING_TIMEOUT 30000
+#define CONN_IDLE_TIMEOUT 10000
+#define STANDBY_TIMEOUT 50
+#define POLL_INTERVAL 10
+#define STANDBY_SLEEPS 3  // light sleeps before the simulated press
+
+// Simulated 4021: loads while latched, shifts on each rising clock
+static uint8_t pressedButtons = 0;
+static uint8_t shiftIndex = 0;
+
+static void onOutput(uint8_t pin, bool high) {
+  if (pin == LATCH_PIN && high) {
+    shiftIndex = 0;
+  } else if (pin == CLK_PIN && high) {
+    shiftIndex++;
+  }
+}
+
+static bool onInput(uint8_t pin) {
+  if (pin != DATA_PIN) {
+    return true;
+  }
+  return shiftIndex >= NesController::BUTTON_COUNT || !((pressedButtons >> shiftIndex) & 1);
+}
+
+static NesController* pad;
+static ActivityTimers* timers;
+
+void setUp(void) {
+  Hal::setOutputHook(onOutput);
+  Hal::setInputHook(onInput);
+  pressedButtons = 0;
+  pad = new NesController(CLK_PIN, LATCH_PIN, DATA_PIN);
+  pad->begin();
+  timers = new ActivityTimers(IDLE_TIMEOUT, ADVERTISING_TIMEOUT, CONN_IDLE_TIMEOUT);
+}
+
+void tearDown(void) {
+  delete timers;
+  delete pad;
+}
+
+// Standby comes back alone, so nothing else runs on the time read before it
+void test_standby_returned_alone(void) {
+  TEST_ASSERT_EQUAL_HEX8(ActivityTimers::ACTION_STOP_ADVERTISING,
+                         timers->check(IDLE_TIMEOUT, true, false, true, false));
+  TEST_ASSERT_EQUAL_HEX8(ActivityTimers::ACTION_STANDBY, timers->check(IDLE_TIMEOUT + 1, true, false, true, false));
+}
+
+// Never standby on external power
+void test_no_standby_on_external_power(void) {
+  TEST_ASSERT_EQUAL_HEX8(0, timers->check(IDLE_TIMEOUT + 1, true, false, false, true));
+}
+
+// On external power the connected-inactive mode still comes, the link relaxes either way
+void test_connected_inactive_on_external_power(void) {
+  timers->markActivity(1000);
+  TEST_ASSERT_EQUAL_HEX8(ActivityTimers::ACTION_ENTER_INACTIVE,
+                         timers->check(1000 + CONN_IDLE_TIMEOUT + 1, false, true, false, true));
+  TEST_ASSERT_TRUE(timers->isInactive());
+}
+
+// Advertising stops once its timeout runs out from the last start
+void test_advertising_timeout(void) {
+  timers->markAdvertisingStart(1000);
+  TEST_ASSERT_EQUAL_HEX8(0, timers->check(1000 + ADVERTISING_TIMEOUT, false, false, true, false));
+  TEST_ASSERT_EQUAL_HEX8(ActivityTimers::ACTION_STOP_ADVERTISING,
+                         timers->check(1000 + ADVERTISING_TIMEOUT + 1, false, false, true, false));
+}
+
+// The connected-inactive mode is entered once, and again only after leaving it
+void test_connected_inactive_once(void) {
+  timers->markActivity(1000);
+  uint32_t now = 1000 + CONN_IDLE_TIMEOUT + 1;
+  TEST_ASSERT_EQUAL_HEX8(ActivityTimers::ACTION_ENTER_INACTIVE, timers->check(now, false, true, false, false));
+  TEST_ASSERT_TRUE(timers->isInactive());
+  TEST_ASSERT_EQUAL_HEX8(0, timers->check(now + POLL_INTERVAL, false, true, false, false));
+
+  timers->markActivity(now);
+  timers->leaveInactive();
+  TEST_ASSERT_FALSE(timers->isInactive());
+  TEST_ASSERT_EQUAL_HEX8(0, timers->check(now + CONN_IDLE_TIMEOUT, false, true, false, false));
+  TEST_ASSERT_EQUAL_HEX8(ActivityTimers::ACTION_ENTER_INACTIVE,
+                         timers->check(now + CONN_IDLE_TIMEOUT + 1, false, true, false, false));
+}
+
+// Without a press standby gives up after its timeout
+void test_standby_times_out(void) {
+  uint32_t sleeps = 0;
+  TEST_ASSERT_FALSE(timers->waitForPress(*pad, STANDBY_TIMEOUT, POLL_INTERVAL, [&sleeps](uint32_t milliseconds) {
+    Hal::delay(milliseconds);
+    sleeps++;
+  }));
+  TEST_ASSERT_TRUE(sleeps >= STANDBY_TIMEOUT / POLL_INTERVAL);
+}
+
+// Waking with START held neither stops the new advertising nor counts as the power off hold
+void test_wake_restarts_timers_and_gestures(void) {
+  // START timed just before standby, released while the pad wasn't checked
+  pressedButtons = 1 << NesController::BUTTON_START;
+  pad->read();
+  pad->updateGestures(1);
+  pressedButtons = 0;
+
+  uint32_t sleeps = 0;
+  TEST_ASSERT_TRUE(timers->waitForPress(*pad, STANDBY_TIMEOUT * 10, POLL_INTERVAL, [&sleeps](uint32_t) {
+    if (++sleeps == STANDBY_SLEEPS) {
+      pressedButtons = 1 << NesController::BUTTON_START;
+    }
+  }));
+  TEST_ASSERT_EQUAL_UINT32(STANDBY_SLEEPS, sleeps);
+
+  uint32_t wake = timers->getLastActivityTime();
+  TEST_ASSERT_TRUE(wake <= Hal::millis());
+  TEST_ASSERT_EQUAL_UINT32(wake, timers->getAdvertisingStartTime());
+  TEST_ASSERT_EQUAL_HEX8(0, timers->check(wake + POLL_INTERVAL, false, false, true, false));
+
+  // Standby outlasted the hold time, START is still timed from the first check after the wake
+  uint32_t now = wake + NesController::POWER_OFF_HOLD_TIME;
+  TEST_ASSERT_EQUAL_HEX8(0, pad->updateGestures(now));
+  TEST_ASSERT_EQUAL_HEX8(0, pad->updateGestures(now + NesController::POWER_OFF_HOLD_TIME - 1));
+  TEST_ASSERT_EQUAL_HEX8(NesController::EVENT_POWER_OFF,
+                         pad->updateGestures(now + NesController::POWER_OFF_HOLD_TIME));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_standby_returned_alone);
+  RUN_TEST(test_no_standby_on_external_power);
+  RUN_TEST(test_connected_inactive_on_external_power);
+  RUN_TEST(test_advertising_timeout);
+  RUN_TEST(test_connected_inactive_once);
+  RUN_TEST(test_standby_times_out);
+  RUN_TEST(test_wake_restarts_timers_and_gestures);
+  return UNITY_END();
+}
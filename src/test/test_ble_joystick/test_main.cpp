@@ -0,0 +1,335 @@
+// test_main.cpp
+// Bluetooth HID NES Advantage Joystick
+// Copyright (C) 2025 Aaron Perkins
+//
+// BLEJoystick report delivery against the NimBLE stand-in: order, congestion
+// accounting, queue draining and per-peer state.
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Preferences.h>
+#include "BLEJoystick.h"
+#include "NimBLEFake.h"
+
+#define HOST_ADDRESS "c0:ff:ee:00:00:01"
+#define SECOND_HOST_ADDRESS "c0:ff:ee:00:00:02"
+#define TX_BUFFERS 2
+#define QUEUED_REPORTS 3
+#define ADVERTISING_TIMEOUT 30000  // milliseconds, as in main.cpp
+#define CONGESTED_TIME 5  // milliseconds the first press waits in the queue
+
+static BLEJoystick* joystick;
+static NimBLECharacteristic* input;
+
+// Connect, bond and subscribe like a new host, with the first report already sent
+static uint16_t connectHost(const char* address) {
+  uint16_t connHandle = NimBLEFake::connect(NimBLEAddress(address));
+  NimBLEFake::encrypt(connHandle);
+  NimBLEFake::subscribe(connHandle, input);
+  NimBLEFake::runHostTasks();
+  joystick->flushReports();
+  NimBLEFake::clearNotifications();
+  return connHandle;
+}
+
+// Find a peer by connection handle
+static const BLEJoystick::PeerLink* findPeer(uint16_t connHandle) {
+  for (uint8_t i = 0; i < joystick->getPeerCount(); i++) {
+    if (joystick->getPeer(i)->connHandle == connHandle) {
+      return joystick->getPeer(i);
+    }
+  }
+  return nullptr;
+}
+
+// Send one distinct report, told apart by its hat byte
+static void sendHat(uint8_t hat) {
+  joystick->setHat(hat);
+  joystick->notifyHIDReport();
+}
+
+// Run out of host buffers: the first TX_BUFFERS reports wait in the controller, the rest in the queue
+static void congest(uint8_t reports) {
+  NimBLEFake::setTxBuffers(TX_BUFFERS);
+  NimBLEFake::setCongested(true);
+  for (uint8_t i = 1; i <= reports; i++) {
+    sendHat(i);
+  }
+}
+
+void setUp(void) {
+  Serial.setMuted(true);
+  Preferences::eraseAll();
+  joystick = new BLEJoystick("NES Advantage");
+  joystick->start();
+  joystick->startAdvertising();
+  NimBLEFake::runHostTasks();
+  input = NimBLEFake::getCharacteristic(NimBLEUUID((uint16_t)0x2A4D));
+}
+
+void tearDown(void) {
+  NimBLEFake::reset();
+  delete joystick;
+  joystick = nullptr;
+}
+
+// Each distinct state goes on air once, in the order it was set
+void test_reports_notified_in_order(void) {
+  uint16_t connHandle = connectHost(HOST_ADDRESS);
+  for (uint8_t hat = 1; hat <= 8; hat++) {
+    sendHat(hat);
+  }
+
+  const std::vector<NimBLEFake::Notification>& notifications = NimBLEFake::getNotifications();
+  TEST_ASSERT_EQUAL(8, notifications.size());
+  for (uint8_t i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL_UINT16(connHandle, notifications[i].connHandle);
+    TEST_ASSERT_EQUAL_UINT16(input->getHandle(), notifications[i].attrHandle);
+    TEST_ASSERT_EQUAL(BLEJoystick::REPORT_SIZE, notifications[i].value.size());
+    TEST_ASSERT_EQUAL_UINT8(i + 1, notifications[i].value[2]);
+  }
+}
+
+// Reports the stack can't take count as ENOMEM failures and stay queued
+void test_congestion_counts_enomem(void) {
+  uint16_t connHandle = connectHost(HOST_ADDRESS);
+  const BLEJoystick::PeerLink* peer = findPeer(connHandle);
+  TEST_ASSERT_NOT_NULL(peer);
+  uint32_t sent = peer->notifySent;
+
+  congest(TX_BUFFERS + QUEUED_REPORTS);
+
+  TEST_ASSERT_EQUAL_UINT32(sent + TX_BUFFERS, peer->notifySent);
+  TEST_ASSERT_EQUAL_UINT32(QUEUED_REPORTS, peer->notifyFailed);
+  TEST_ASSERT_EQUAL_UINT32(QUEUED_REPORTS, peer->mbufExhausted);
+  TEST_ASSERT_EQUAL_UINT8(QUEUED_REPORTS, peer->queueCount);
+  TEST_ASSERT_EQUAL_UINT16(TX_BUFFERS, NimBLEFake::getPendingTx(connHandle));
+  TEST_ASSERT_EQUAL(0, os_msys_num_free());
+  TEST_ASSERT_EQUAL(0, NimBLEFake::getNotifications().size());
+}
+
+// Once the link clears the queue drains in order, nothing lost or repeated
+void test_queue_drains_in_order(void) {
+  uint16_t connHandle = connectHost(HOST_ADDRESS);
+  const BLEJoystick::PeerLink* peer = findPeer(connHandle);
+  congest(TX_BUFFERS + QUEUED_REPORTS);
+
+  NimBLEFake::setCongested(false);
+  NimBLEFake::runHostTasks();
+  TEST_ASSERT_EQUAL(TX_BUFFERS, NimBLEFake::getNotifications().size());
+  joystick->flushReports();
+
+  const std::vector<NimBLEFake::Notification>& notifications = NimBLEFake::getNotifications();
+  TEST_ASSERT_EQUAL(TX_BUFFERS + QUEUED_REPORTS, notifications.size());
+  for (uint8_t i = 0; i < notifications.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT8(i + 1, notifications[i].value[2]);
+  }
+  TEST_ASSERT_EQUAL_UINT8(0, peer->queueCount);
+  TEST_ASSERT_EQUAL_UINT32(QUEUED_REPORTS - 1, peer->statesRecovered);
+  TEST_ASSERT_EQUAL_UINT32(0, peer->statesDropped);
+
+  // Nothing left to retry
+  joystick->flushReports();
+  TEST_ASSERT_EQUAL(TX_BUFFERS + QUEUED_REPORTS, notifications.size());
+}
+
+// A host that stops taking reports holds at most its cap of the shared buffers, the other host
+// keeps getting every report
+void test_stalled_peer_keeps_to_its_cap(void) {
+  uint16_t stalled = connectHost(HOST_ADDRESS);
+  uint16_t healthy = connectHost(SECOND_HOST_ADDRESS);
+  NimBLEFake::setStalled(stalled, true);
+  for (uint8_t i = 0; i < NimBLEFake::DEFAULT_TX_BUFFERS; i++) {
+    sendHat(i % 8 + 1);
+  }
+
+  const BLEJoystick::PeerLink* peer = findPeer(stalled);
+  TEST_ASSERT_EQUAL_UINT8(BLEJoystick::MAX_TX_IN_FLIGHT, peer->txInFlight);
+  TEST_ASSERT_EQUAL_UINT16(BLEJoystick::MAX_TX_IN_FLIGHT, NimBLEFake::getPendingTx(stalled));
+  TEST_ASSERT_TRUE(peer->notifyDeferred > 0);
+  TEST_ASSERT_EQUAL_UINT32(0, peer->mbufExhausted);
+  TEST_ASSERT_EQUAL(NimBLEFake::DEFAULT_TX_BUFFERS - BLEJoystick::MAX_TX_IN_FLIGHT, os_msys_num_free());
+
+  peer = findPeer(healthy);
+  TEST_ASSERT_EQUAL_UINT32(0, peer->notifyFailed);
+  TEST_ASSERT_EQUAL_UINT8(0, peer->txInFlight);
+  uint16_t delivered = 0;
+  for (const NimBLEFake::Notification& notification : NimBLEFake::getNotifications()) {
+    delivered += notification.connHandle == healthy;
+  }
+  TEST_ASSERT_EQUAL_UINT16(NimBLEFake::DEFAULT_TX_BUFFERS, delivered);
+
+  // Once the host acknowledges again its queue drains
+  NimBLEFake::setStalled(stalled, false);
+  NimBLEFake::runHostTasks();
+  joystick->flushReports();
+  NimBLEFake::runHostTasks();
+  peer = findPeer(stalled);
+  TEST_ASSERT_EQUAL_UINT8(0, peer->queueCount);
+  TEST_ASSERT_EQUAL_UINT8(0, peer->txInFlight);
+  TEST_ASSERT_EQUAL(NimBLEFake::DEFAULT_TX_BUFFERS, os_msys_num_free());
+}
+
+// The first press is timed until the stack takes its report, not just until it is queued
+void test_first_press_timed_to_the_stack(void) {
+  connectHost(HOST_ADDRESS);
+  congest(TX_BUFFERS);
+  TEST_ASSERT_EQUAL_UINT16(0, joystick->getFirstPressLatency());
+
+  joystick->markFirstPress(micros());
+  sendHat(TX_BUFFERS + 1);
+  delay(CONGESTED_TIME);
+  joystick->flushReports();
+  TEST_ASSERT_EQUAL_UINT16(0, joystick->getFirstPressLatency());
+
+  NimBLEFake::setCongested(false);
+  NimBLEFake::runHostTasks();
+  joystick->flushReports();
+  TEST_ASSERT_TRUE(joystick->getFirstPressLatency() >= CONGESTED_TIME);
+
+  // Only the marked press counts
+  uint16_t latency = joystick->getFirstPressLatency();
+  delay(CONGESTED_TIME);
+  sendHat(TX_BUFFERS + 2);
+  TEST_ASSERT_EQUAL_UINT16(latency, joystick->getFirstPressLatency());
+}
+
+// A CCCD write drops what was queued, a new subscription starts from the current state only
+void test_subscribe_clears_queue(void) {
+  uint16_t connHandle = connectHost(HOST_ADDRESS);
+  const BLEJoystick::PeerLink* peer = findPeer(connHandle);
+  congest(TX_BUFFERS + QUEUED_REPORTS);
+  TEST_ASSERT_EQUAL_UINT8(QUEUED_REPORTS, peer->queueCount);
+
+  NimBLEFake::subscribe(connHandle, input, false);
+  TEST_ASSERT_FALSE(peer->subscribed);
+  TEST_ASSERT_EQUAL_UINT8(0, peer->queueCount);
+
+  NimBLEFake::setCongested(false);
+  NimBLEFake::runHostTasks();
+  NimBLEFake::clearNotifications();
+  joystick->flushReports();
+  TEST_ASSERT_EQUAL(0, NimBLEFake::getNotifications().size());
+
+  NimBLEFake::subscribe(connHandle, input, true);
+  TEST_ASSERT_TRUE(peer->subscribed);
+  TEST_ASSERT_EQUAL_UINT8(1, peer->queueCount);
+  joystick->flushReports();
+  TEST_ASSERT_EQUAL(1, NimBLEFake::getNotifications().size());
+  TEST_ASSERT_EQUAL_UINT8(TX_BUFFERS + QUEUED_REPORTS, NimBLEFake::getNotifications()[0].value[2]);
+}
+
+// A disconnect drops the peer with its queue and counters, the other peer is left alone
+void test_disconnect_clears_peer(void) {
+  uint16_t first = connectHost(HOST_ADDRESS);
+  uint16_t second = connectHost(SECOND_HOST_ADDRESS);
+  TEST_ASSERT_EQUAL_UINT8(2, joystick->getPeerCount());
+  congest(TX_BUFFERS + QUEUED_REPORTS);
+  uint32_t secondFailed = findPeer(second)->notifyFailed;
+
+  NimBLEFake::disconnect(first, NimBLEFake::REASON_SUPERVISION_TIMEOUT);
+  TEST_ASSERT_EQUAL_UINT8(1, joystick->getPeerCount());
+  TEST_ASSERT_NULL(findPeer(first));
+  TEST_ASSERT_NOT_NULL(findPeer(second));
+  TEST_ASSERT_EQUAL_UINT32(secondFailed, findPeer(second)->notifyFailed);
+  TEST_ASSERT_EQUAL_UINT16(1, joystick->getSupervisionTimeouts());
+
+  // The same host comes back on a clean link
+  NimBLEFake::setCongested(false);
+  NimBLEFake::runHostTasks();
+  joystick->flushReports();
+  uint16_t again = connectHost(HOST_ADDRESS);
+  const BLEJoystick::PeerLink* peer = findPeer(again);
+  TEST_ASSERT_NOT_NULL(peer);
+  TEST_ASSERT_EQUAL_UINT32(1, peer->notifySent);
+  TEST_ASSERT_EQUAL_UINT32(0, peer->notifyFailed);
+  TEST_ASSERT_EQUAL_UINT32(0, peer->mbufExhausted);
+  TEST_ASSERT_EQUAL_UINT32(0, peer->statesRecovered);
+  TEST_ASSERT_EQUAL_UINT8(0, peer->queueCount);
+}
+
+// Pairing another host keeps the bond of the one still connected
+void test_second_host_keeps_first_bond(void) {
+  connectHost(HOST_ADDRESS);
+  joystick->startAdvertising();
+  connectHost(SECOND_HOST_ADDRESS);
+
+  TEST_ASSERT_TRUE(NimBLEDevice::isBonded(NimBLEAddress(HOST_ADDRESS)));
+  TEST_ASSERT_TRUE(NimBLEDevice::isBonded(NimBLEAddress(SECOND_HOST_ADDRESS)));
+  TEST_ASSERT_TRUE(joystick->hasHost(0));
+  TEST_ASSERT_TRUE(joystick->hasHost(1));
+  TEST_ASSERT_EQUAL_UINT8(1, joystick->getActiveHost());
+}
+
+// A returning bonded host gets reports as soon as the stack restores its CCCD, and only if
+// notifications were still on when it left
+void test_reconnect_follows_restored_cccd(void) {
+  uint16_t connHandle = connectHost(HOST_ADDRESS);
+  NimBLEFake::disconnect(connHandle);
+
+  connHandle = NimBLEFake::connect(NimBLEAddress(HOST_ADDRESS));
+  NimBLEFake::encrypt(connHandle);
+  const BLEJoystick::PeerLink* peer = findPeer(connHandle);
+  TEST_ASSERT_NOT_NULL(peer);
+  TEST_ASSERT_TRUE(peer->subscribed);
+  TEST_ASSERT_TRUE(peer->subscribeTime >= peer->encryptTime);
+  NimBLEFake::clearNotifications();
+  joystick->flushReports();
+  TEST_ASSERT_EQUAL(1, NimBLEFake::getNotifications().size());
+  TEST_ASSERT_TRUE(peer->firstReportTime > 0);
+
+  NimBLEFake::subscribe(connHandle, input, false);
+  NimBLEFake::disconnect(connHandle);
+  connHandle = NimBLEFake::connect(NimBLEAddress(HOST_ADDRESS));
+  NimBLEFake::encrypt(connHandle);
+  TEST_ASSERT_FALSE(findPeer(connHandle)->subscribed);
+}
+
+// A bonded host is tried directed first, then the general schedule runs its tiers in order,
+// all started well inside the advertising timeout
+void test_reconnect_falls_back_through_tiers(void) {
+  uint16_t connHandle = connectHost(HOST_ADDRESS);
+  NimBLEFake::disconnect(connHandle);
+  joystick->startAdvertising();
+
+  NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+  TEST_ASSERT_EQUAL_UINT8(BLEJoystick::ADV_TIER_DIRECTED, joystick->getAdvertisingTier());
+  TEST_ASSERT_EQUAL_UINT8(BLE_GAP_CONN_MODE_DIR, pAdvertising->getAdvertisementType());
+  TEST_ASSERT_TRUE(pAdvertising->getDirectedAddress() == NimBLEAddress(HOST_ADDRESS));
+  uint32_t elapsed = pAdvertising->getDuration() * 1000;
+
+  // Durations are seconds, so nothing runs out straight away
+  NimBLEFake::runHostTasks();
+  TEST_ASSERT_TRUE(joystick->isReconnecting());
+
+  for (uint8_t tier = 0; tier < 2; tier++) {
+    NimBLEFake::completeAdvertising();
+    TEST_ASSERT_TRUE(joystick->isAdvertising());
+    TEST_ASSERT_EQUAL_UINT8(tier, joystick->getAdvertisingTier());
+    TEST_ASSERT_EQUAL_UINT8(BLE_GAP_CONN_MODE_UND, pAdvertising->getAdvertisementType());
+    TEST_ASSERT_TRUE(pAdvertising->getDuration() > 0);
+    TEST_ASSERT_TRUE(elapsed < ADVERTISING_TIMEOUT);
+    elapsed += pAdvertising->getDuration() * 1000;
+  }
+
+  // The last tier runs until the timeout stops advertising
+  NimBLEFake::completeAdvertising();
+  TEST_ASSERT_EQUAL_UINT8(2, joystick->getAdvertisingTier());
+  TEST_ASSERT_EQUAL_UINT32(0, pAdvertising->getDuration());
+  TEST_ASSERT_TRUE(elapsed < ADVERTISING_TIMEOUT);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_reports_notified_in_order);
+  RUN_TEST(test_congestion_counts_enomem);
+  RUN_TEST(test_queue_drains_in_order);
+  RUN_TEST(test_stalled_peer_keeps_to_its_cap);
+  RUN_TEST(test_first_press_timed_to_the_stack);
+  RUN_TEST(test_subscribe_clears_queue);
+  RUN_TEST(test_disconnect_clears_peer);
+  RUN_TEST(test_second_host_keeps_first_bond);
+  RUN_TEST(test_reconnect_follows_restored_cccd);
+  RUN_TEST(test_reconnect_falls_back_through_tiers);
+  return UNITY_END();
+}